@@ -39,11 +39,14 @@ using namespace rapidjson;
 
 - (id) parse:(NSString*)json {
     
-    NSMutableDictionary *result = [[NSMutableDictionary alloc] init];
     const char* data = [json UTF8String];
     
     Document d;
     d.Parse(data);
+    if (d.HasParseError()) {
+        fprintf(stderr, "parse error %d at %zu\n", (int)d.GetParseError(), d.GetErrorOffset());
+        return nil;
+    }
     
     /*static const char* kTypeNames[] = { "Null", "False", "True", "Object", "Array", "String", "Number" };
     for (Value::ConstMemberIterator itr = d.MemberBegin(); itr != d.MemberEnd(); ++itr) {
@@ -51,7 +54,7 @@ using namespace rapidjson;
         const Value& a = itr->value;
     }*/
     
-    return result;
+    return [NSNumber numberWithBool:YES];
 }
 
 - (void) test {
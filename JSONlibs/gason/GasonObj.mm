@@ -15,20 +15,25 @@ static void traverse(std::string k, JsonValue v) {
     switch (v.getTag()) {
         case JSON_ARRAY:
             for (auto i : v) {
-                traverse(i->key,i->value);
+                traverse(k, i->value);
             }
             break;
         case JSON_OBJECT:
             for (auto i : v) {
-                traverse(i->key, i->value);
+                traverse(std::string(i->keyView->data, i->keyView->length), i->value);
             }
             break;
-        case JSON_STRING:
-            printf("%s:%s\n", k.c_str(), v.toString() );
+        case JSON_STRING: {
+            JsonStringView s = v.toStringView();
+            printf("%s:%.*s\n", k.c_str(), (int)s.length, s.data );
             break;
+        }
         case JSON_NUMBER:
             printf("%s:%f\n", k.c_str(), v.toNumber() );
             break;
+        case JSON_INTEGER:
+            printf("%s:%lld\n", k.c_str(), (long long)v.toInteger() );
+            break;
         case JSON_TRUE:printf("%s:%f\n", k.c_str(), v.toNumber() );
             break;
         case JSON_FALSE:
@@ -43,17 +48,15 @@ static void traverse(std::string k, JsonValue v) {
     
     id result = nil;
     
-    std::string str  = [json UTF8String];
-    char *source = new char[str.size()+1];
-    strcpy(source, str.c_str());
-    
-    //printf("JSON is %s\n", str.c_str());
+    // Parsed as a const buffer, so the UTF-8 bytes are used without a copy;
+    // they must stay alive as long as value.
+    const char *source = [json UTF8String];
     
-    char *endptr;
+    const char *endptr;
     JsonValue value;
     JsonAllocator allocator;
     
-    int status = jsonParse(source, &endptr, &value, allocator);
+    int status = jsonParse(source, strlen(source), &endptr, &value, allocator);
     if (status != JSON_OK) {
         fprintf(stderr, "%s at %zd\n", jsonStrError(status), endptr - source);
     } else {
@@ -63,7 +66,6 @@ static void traverse(std::string k, JsonValue v) {
         }*/
         result=[NSNumber numberWithBool:YES];
     }
-    //free(source);
     return result;
 }
 
@@ -1,8 +1,35 @@
 #include "gason.h"
+#include "gason_pow5.h"
+#include "gason_pow10.h"
+#include <float.h>
+#include <locale.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
 
-#define JSON_ZONE_SIZE 4096
-#define JSON_STACK_SIZE 32
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+#endif
+
+// JSON_EXACT_READS turns off the in situ scanners that read past the NUL,
+// as described in gason.h. AddressSanitizer reports those reads, so it is
+// the default under it.
+#if !defined(JSON_EXACT_READS)
+#if defined(__SANITIZE_ADDRESS__)
+#define JSON_EXACT_READS
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define JSON_EXACT_READS
+#endif
+#endif
+#endif
 
 const char *jsonStrError(int err) {
     switch (err) {
@@ -19,18 +46,35 @@ const char *jsonStrError(int err) {
 void *JsonAllocator::allocate(size_t size) {
     size = (size + 7) & ~7;
 
-    if (head && head->used + size <= JSON_ZONE_SIZE) {
+    if (head && head->used + size <= head->size) {
         char *p = (char *)head + head->used;
         head->used += size;
         return p;
     }
 
+    return allocateZone(size);
+}
+
+void *JsonAllocator::allocateZone(size_t size) {
     size_t allocSize = sizeof(Zone) + size;
-    Zone *zone = (Zone *)malloc(allocSize <= JSON_ZONE_SIZE ? JSON_ZONE_SIZE : allocSize);
-    if (zone == nullptr)
-        return nullptr;
+    Zone *zone = spare;
+    if (zone && zone->size >= allocSize) {
+        spare = zone->next;
+        spareBytes -= zone->size;
+    } else {
+        bool oversized = allocSize > nextZoneSize;
+        size_t zoneBytes = oversized ? allocSize : nextZoneSize;
+        zone = (Zone *)malloc(zoneBytes);
+        if (zone == nullptr)
+            return nullptr;
+        zone->size = zoneBytes;
+        ++mallocs;
+        if (!oversized && nextZoneSize < maxZoneSize)
+            nextZoneSize = nextZoneSize * 2 < maxZoneSize ? nextZoneSize * 2 : maxZoneSize;
+    }
     zone->used = allocSize;
-    if (allocSize <= JSON_ZONE_SIZE || head == nullptr) {
+    // Keep allocating from whichever of the two zones has more room left.
+    if (head == nullptr || zone->size - zone->used >= head->size - head->used) {
         zone->next = head;
         head = zone;
     } else {
@@ -44,10 +88,69 @@ void JsonAllocator::deallocate() {
     while (head) {
         Zone *next = head->next;
         free(head);
+        ++frees;
+        head = next;
+    }
+    while (spare) {
+        Zone *next = spare->next;
+        free(spare);
+        ++frees;
+        spare = next;
+    }
+    spareBytes = 0;
+    nextZoneSize = zoneSize;
+    indexes = nullptr;
+}
+
+void JsonAllocator::reset() {
+    indexes = nullptr;
+    // Pushing onto the spare list reverses it, so zones are reused in the
+    // order they were first allocated.
+    while (head) {
+        Zone *next = head->next;
+        if (spareBytes + head->size <= retainLimit) {
+            head->next = spare;
+            spare = head;
+            spareBytes += head->size;
+        } else {
+            free(head);
+            ++frees;
+        }
         head = next;
     }
 }
 
+void JsonAllocator::setZoneSize(size_t size, size_t maxSize) {
+    zoneSize = nextZoneSize = size > sizeof(Zone) ? size : sizeof(Zone);
+    maxZoneSize = maxSize > zoneSize ? maxSize : zoneSize;
+}
+
+JsonAllocatorStats JsonAllocator::stats() const {
+    JsonAllocatorStats result = {0, 0, 0, spareBytes, mallocs, frees};
+    for (Zone *zone = head; zone; zone = zone->next) {
+        ++result.zones;
+        result.usedBytes += zone->used - sizeof(Zone);
+        result.reservedBytes += zone->size;
+    }
+    return result;
+}
+
+void JsonAllocator::moveFrom(JsonAllocator &x) {
+    head = x.head;
+    spare = x.spare;
+    spareBytes = x.spareBytes;
+    zoneSize = x.zoneSize;
+    maxZoneSize = x.maxZoneSize;
+    nextZoneSize = x.nextZoneSize;
+    retainLimit = x.retainLimit;
+    mallocs = x.mallocs;
+    frees = x.frees;
+    indexes = x.indexes;
+    x.head = x.spare = nullptr;
+    x.spareBytes = 0;
+    x.indexes = nullptr;
+}
+
 static inline bool isspace(char c) {
     return c == ' ' || (c >= '\t' && c <= '\r');
 }
@@ -70,50 +173,622 @@ static inline int char2int(char c) {
     return (c & ~' ') - 'A' + 10;
 }
 
-static double string2double(char *s, char **endptr) {
-    char ch = *s;
-    if (ch == '-')
+// Bytes that end a plain run inside a string: the quote, a backslash, and
+// control characters including the NUL terminator and DEL.
+static inline bool isstringspecial(char c) {
+    return c == '"' || c == '\\' || (unsigned char)c < ' ' || c == '\x7F';
+}
+
+#if defined(__SSE2__)
+static inline unsigned stringSpecialMask(__m128i v) {
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+    return (unsigned)_mm_movemask_epi8(special);
+}
+
+static inline unsigned spaceMask(__m128i v) {
+    __m128i control = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i space = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control);
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(space, _mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+}
+#endif
+
+// The in situ scanners only issue aligned loads. An aligned block never
+// straddles a page, so reading past the terminating NUL, or before the
+// start of the buffer, within the block that holds it cannot fault;
+// memory checkers report it all the same, hence JSON_EXACT_READS.
+#if defined(__SSE2__) && !defined(JSON_EXACT_READS)
+static size_t spaceRunSse2(const char *p) {
+    for (const char *q = p;; q += 16) {
+        unsigned mask = ~spaceMask(_mm_load_si128((const __m128i *)q)) & 0xFFFF;
+        if (mask)
+            return q - p + __builtin_ctz(mask);
+    }
+}
+
+#ifdef JSON_AVX2_DISPATCH
+__attribute__((target("avx2"))) static size_t spaceRunAvx2(const char *p) {
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i controls = _mm256_set1_epi8('\r' - '\t');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const char *q = (const char *)((uintptr_t)p & ~(uintptr_t)31);
+    for (unsigned skip = (unsigned)(p - q);; q += 32, skip = 0) {
+        __m256i v = _mm256_load_si256((const __m256i *)q);
+        __m256i control = _mm256_sub_epi8(v, tab);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(control, controls), control),
+                                     _mm256_cmpeq_epi8(v, space));
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(ws) >> skip;
+        if (mask)
+            return q + skip - p + __builtin_ctz(mask);
+    }
+}
+
+static size_t (*selectSpaceRun())(const char *) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? spaceRunAvx2 : spaceRunSse2;
+}
+#endif
+
+// Whitespace is skipped 16 or 32 bytes at a time. Single separators as in
+// ": " are common enough to be tested before touching vector registers,
+// and indentation in pretty printed documents rarely exceeds the first
+// block.
+static inline char *skipSpace(char *s) {
+    if (!isspace(*s))
+        return s;
+    if (!isspace(*++s))
+        return s;
+    const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)15);
+    unsigned mask = ~spaceMask(_mm_load_si128((const __m128i *)p)) & 0xFFFF;
+    mask >>= s - p;
+    if (mask)
+        return s + __builtin_ctz(mask);
+    p += 16;
+#ifdef JSON_AVX2_DISPATCH
+    static size_t (*const run)(const char *) = selectSpaceRun();
+    return (char *)p + run(p);
+#else
+    return (char *)p + spaceRunSse2(p);
+#endif
+}
+
+// p is 16-byte aligned.
+static size_t stringRunSse2(const char *p) {
+    for (const char *q = p;; q += 16) {
+        unsigned mask = stringSpecialMask(_mm_load_si128((const __m128i *)q));
+        if (mask)
+            return q - p + __builtin_ctz(mask);
+    }
+}
+
+#ifdef JSON_AVX2_DISPATCH
+__attribute__((target("avx2"))) static size_t stringRunAvx2(const char *p) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    const char *q = (const char *)((uintptr_t)p & ~(uintptr_t)31);
+    for (unsigned skip = (unsigned)(p - q);; q += 32, skip = 0) {
+        __m256i v = _mm256_load_si256((const __m256i *)q);
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash));
+        special = _mm256_or_si256(special, _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+        special = _mm256_or_si256(special, _mm256_cmpeq_epi8(v, del));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(special) >> skip;
+        if (mask)
+            return q + skip - p + __builtin_ctz(mask);
+    }
+}
+
+static size_t (*selectStringRun())(const char *) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? stringRunAvx2 : stringRunSse2;
+}
+#endif
+
+// Length of the plain run starting at s. The first block is checked
+// inline since most keys and short values end there; longer runs go to
+// the widest scanner the CPU has.
+static inline size_t stringRun(const char *s) {
+    const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)15);
+    unsigned mask = stringSpecialMask(_mm_load_si128((const __m128i *)p)) >> (s - p);
+    if (mask)
+        return __builtin_ctz(mask);
+    p += 16;
+#ifdef JSON_AVX2_DISPATCH
+    static size_t (*const run)(const char *) = selectStringRun();
+    return p - s + run(p);
+#else
+    return p - s + stringRunSse2(p);
+#endif
+}
+#else
+static inline size_t stringRun(const char *s) {
+    const char *p = s;
+    while (!isstringspecial(*p))
+        ++p;
+    return p - s;
+}
+
+static inline char *skipSpace(char *s) {
+    while (isspace(*s))
+        ++s;
+    return s;
+}
+#endif
+
+// Bounded versions for buffers without a terminator: s < end. Blocks are
+// loaded unaligned and only while they fit before end, and the last few
+// bytes are checked one at a time, so nothing outside [s, end) is read.
+#if defined(__SSE2__)
+static inline size_t stringRunBounded(const char *s, const char *end) {
+    const char *p = s;
+    for (; end - p >= 16; p += 16) {
+        unsigned mask = stringSpecialMask(_mm_loadu_si128((const __m128i *)p));
+        if (mask)
+            return p - s + __builtin_ctz(mask);
+    }
+    while (p < end && !isstringspecial(*p))
+        ++p;
+    return p - s;
+}
+
+static inline const char *skipSpaceBounded(const char *s, const char *end) {
+    if (!isspace(*s) || ++s == end || !isspace(*s))
+        return s;
+    for (; end - s >= 16; s += 16) {
+        unsigned mask = ~spaceMask(_mm_loadu_si128((const __m128i *)s)) & 0xFFFF;
+        if (mask)
+            return s + __builtin_ctz(mask);
+    }
+    while (s < end && isspace(*s))
+        ++s;
+    return s;
+}
+#else
+static inline size_t stringRunBounded(const char *s, const char *end) {
+    const char *p = s;
+    while (p < end && !isstringspecial(*p))
+        ++p;
+    return p - s;
+}
+
+static inline const char *skipSpaceBounded(const char *s, const char *end) {
+    while (s < end && isspace(*s))
         ++s;
+    return s;
+}
+#endif
+
+// UTF-8 validation. Escapes and the characters that end a plain run are
+// ASCII, so a well-formed sequence never spans two runs and each run can
+// be checked on its own.
+
+// Returns the first byte of the first ill-formed sequence in [s, end), or
+// nullptr; the ranges are those of table 3-7 in the Unicode standard.
+static const char *utf8ErrorScalar(const char *s, const char *end) {
+    const unsigned char *p = (const unsigned char *)s;
+    const unsigned char *e = (const unsigned char *)end;
+    while (p < e) {
+        unsigned c = *p;
+        if (c < 0x80) {
+            ++p;
+            continue;
+        }
+        size_t n;
+        unsigned low = 0x80, high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            n = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            n = 2;
+            if (c == 0xE0)
+                low = 0xA0;
+            else if (c == 0xED)
+                high = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            n = 3;
+            if (c == 0xF0)
+                low = 0x90;
+            else if (c == 0xF4)
+                high = 0x8F;
+        } else {
+            return (const char *)p;
+        }
+        if ((size_t)(e - p) <= n || p[1] < low || p[1] > high)
+            return (const char *)p;
+        for (size_t i = 2; i <= n; ++i)
+            if ((p[i] & 0xC0) != 0x80)
+                return (const char *)p;
+        p += n + 1;
+    }
+    return nullptr;
+}
+
+#ifdef JSON_AVX2_DISPATCH
+// The lookup algorithm of Keiser and Lemire, "Validating UTF-8 In Less
+// Than One Instruction Per Byte", as in simdjson. Each byte and its
+// predecessor index three 16-entry tables of error classes whose AND is
+// nonzero for every bad two-byte pattern; third and fourth bytes are
+// checked against the lead bytes two and three back. Blocks are loaded
+// unaligned from s, the last partial one from a zero-padded copy, so that
+// nothing outside [s, end) is read.
+__attribute__((target("avx2"))) static bool utf8ValidAvx2(const char *s, const char *end) {
+    enum {
+        TOO_SHORT = 1 << 0,
+        TOO_LONG = 1 << 1,
+        OVERLONG_3 = 1 << 2,
+        TOO_LARGE = 1 << 3,
+        SURROGATE = 1 << 4,
+        OVERLONG_2 = 1 << 5,
+        TOO_LARGE_1000 = 1 << 6,
+        OVERLONG_4 = 1 << 6,
+        TWO_CONTS = 1 << 7,
+        CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS,
+    };
+#define JSON_TABLE16(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+    const __m256i byte1High = JSON_TABLE16(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TWO_CONTS, TWO_CONTS,
+        TWO_CONTS, TWO_CONTS, TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const __m256i byte1Low = JSON_TABLE16(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY, CARRY, CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000);
+    const __m256i byte2High = JSON_TABLE16(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE, TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+#undef JSON_TABLE16
+    // A lead byte in one of the last three positions still needs bytes
+    // from the next block.
+    const __m256i maxFinal = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1),
+                                              (char)(0xE0 - 1), (char)(0xC0 - 1));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i previous = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+    for (const char *q = s; q < end; q += 32) {
+        __m256i v;
+        if (end - q >= 32) {
+            v = _mm256_loadu_si256((const __m256i *)q);
+        } else {
+            char tail[32] = {0};
+            memcpy(tail, q, end - q);
+            v = _mm256_loadu_si256((const __m256i *)tail);
+        }
+        __m256i shifted = _mm256_permute2x128_si256(previous, v, 0x21);
+        __m256i prev1 = _mm256_alignr_epi8(v, shifted, 15);
+        __m256i prev2 = _mm256_alignr_epi8(v, shifted, 14);
+        __m256i prev3 = _mm256_alignr_epi8(v, shifted, 13);
+        __m256i special = _mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+        special = _mm256_and_si256(special, _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, nibble)));
+        special = _mm256_and_si256(
+            special, _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+        __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+                                         _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+        must23 = _mm256_and_si256(must23, _mm256_set1_epi8((char)0x80));
+        error = _mm256_or_si256(error, _mm256_xor_si256(must23, special));
+        incomplete = _mm256_subs_epu8(v, maxFinal);
+        previous = v;
+    }
+    error = _mm256_or_si256(error, incomplete);
+    return _mm256_testz_si256(error, error);
+}
+
+static bool (*selectUtf8Valid())(const char *, const char *) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? utf8ValidAvx2 : nullptr;
+}
+#endif
+
+// utf8ErrorScalar for runs that are not all ASCII. The lookup algorithm
+// decides, and only a run it rejects is walked byte by byte to find the
+// offending sequence.
+static inline const char *utf8Error(const char *s, const char *end) {
+#ifdef JSON_AVX2_DISPATCH
+    static bool (*const valid)(const char *, const char *) = selectUtf8Valid();
+    if (valid && valid(s, end))
+        return nullptr;
+#endif
+    return utf8ErrorScalar(s, end);
+}
+
+// stringRun for validating parses; bad is set to the offending byte if
+// the run is not well-formed UTF-8. The blocks the run is found in also
+// show whether it is ASCII, so only other runs are scanned again.
+static inline size_t checkedStringRun(const char *s, const char *&bad) {
+#if defined(__SSE2__) && !defined(JSON_EXACT_READS)
+    const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)15);
+    __m128i v = _mm_load_si128((const __m128i *)p);
+    unsigned mask = stringSpecialMask(v) >> (s - p) << (s - p);
+    unsigned bytes = (unsigned)_mm_movemask_epi8(v) >> (s - p) << (s - p);
+    unsigned high = 0;
+    while (!mask) {
+        high |= bytes;
+        p += 16;
+        v = _mm_load_si128((const __m128i *)p);
+        mask = stringSpecialMask(v);
+        bytes = (unsigned)_mm_movemask_epi8(v);
+    }
+    high |= bytes & ((mask & (0 - mask)) - 1);
+    size_t run = p + __builtin_ctz(mask) - s;
+    bad = high ? utf8Error(s, s + run) : nullptr;
+    return run;
+#else
+    size_t run = stringRun(s);
+    bad = utf8Error(s, s + run);
+    return run;
+#endif
+}
+
+// The same for buffers without a terminator, as stringRunBounded.
+static inline size_t checkedStringRunBounded(const char *s, const char *end, const char *&bad) {
+#if defined(__SSE2__)
+    const char *p = s;
+    unsigned high = 0;
+    for (;; p += 16) {
+        if (end - p < 16) {
+            while (p < end && !isstringspecial(*p))
+                high |= (unsigned char)*p++ & 0x80;
+            break;
+        }
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned mask = stringSpecialMask(v);
+        unsigned bytes = (unsigned)_mm_movemask_epi8(v);
+        if (mask) {
+            high |= bytes & ((mask & (0 - mask)) - 1);
+            p += __builtin_ctz(mask);
+            break;
+        }
+        high |= bytes;
+    }
+    bad = high ? utf8Error(s, p) : nullptr;
+    return p - s;
+#else
+    size_t run = stringRunBounded(s, end);
+    bad = utf8Error(s, s + run);
+    return run;
+#endif
+}
+
+// Converts eight digits at once as in fast_float; the first character is
+// in the low byte, and bytes already reduced to 0 act as leading zeros.
+static inline uint32_t eightDigitsValue(uint64_t chunk) {
+    chunk = (chunk * 10) + (chunk >> 8);
+    return (uint32_t)((((chunk & 0x000000FF000000FF) * 0x000F424000000064) +
+                       (((chunk >> 16) & 0x000000FF000000FF) * 0x0000271000000001)) >>
+                      32);
+}
 
-    double result = 0;
+// Accumulates a run of digits into mantissa, wrapping around past 19 of
+// them. Eight bytes are loaded at a time and the digits among them are
+// converted together, so short runs cost one load as well. The loads stay
+// below limit; the digits beyond it are read one at a time.
+static inline char *parseDigits(char *s, const char *limit, uint64_t &mantissa) {
+#if defined(__GNUC__) && !(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    static const uint32_t kScale[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+    while (limit - s >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, s, 8);
+        uint64_t nondigits = ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ^
+                             0x3333333333333333;
+        unsigned n = nondigits ? __builtin_ctzll(nondigits) >> 3 : 8;
+        if (n == 0)
+            return s;
+        mantissa = mantissa * kScale[n] + eightDigitsValue((chunk - 0x3030303030303030) << (64 - 8 * n));
+        s += n;
+        if (n < 8)
+            return s;
+    }
+#endif
     while (isdigit(*s))
-        result = (result * 10) + (*s++ - '0');
+        mantissa = mantissa * 10 + (*s++ - '0');
+    return s;
+}
 
-    if (*s == '.') {
+static inline void multiply128(uint64_t a, uint64_t b, uint64_t &high, uint64_t &low) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128)a * b;
+    high = (uint64_t)(product >> 64);
+    low = (uint64_t)product;
+#else
+    uint64_t ll = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t lh = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hl = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t hh = (a >> 32) * (b >> 32);
+    uint64_t middle = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+    low = (middle << 32) | (ll & 0xFFFFFFFF);
+    high = hh + (lh >> 32) + (hl >> 32) + (middle >> 32);
+#endif
+}
+
+static inline int leadingZeros(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    for (; !(x & 0x8000000000000000); x <<= 1)
+        ++n;
+    return n;
+#endif
+}
+
+// Eisel-Lemire: the bits of the binary64 nearest to w * 10^q, rounding
+// ties to even. Exact for every w below 10^19.
+static uint64_t decimalToBinary(uint64_t w, int64_t q) {
+    if (w == 0 || q < JSON_POW5_MIN)
+        return 0;
+    if (q > JSON_POW5_MAX)
+        return 0x7FF0000000000000;
+
+    int lz = leadingZeros(w);
+    w <<= lz;
+    const uint64_t *pow5 = kPow5[q - JSON_POW5_MIN];
+    uint64_t high, low;
+    multiply128(w, pow5[0], high, low);
+    if ((high & 0x1FF) == 0x1FF) {
+        uint64_t high2, low2;
+        multiply128(w, pow5[1], high2, low2);
+        low += high2;
+        if (high2 > low)
+            ++high;
+    }
+
+    int upper = (int)(high >> 63);
+    int shift = upper + 9;
+    uint64_t mantissa = high >> shift;
+    int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - lz + 1023;
+
+    if (power2 <= 0) {
+        // Subnormal; rounding up may carry into the smallest normal exponent.
+        if (-power2 + 1 >= 64)
+            return 0;
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        return mantissa >> 1;
+    }
+
+    // An exact product halfway between two doubles only happens for small
+    // powers of ten; round it to even instead of up.
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high)
+        mantissa &= ~(uint64_t)1;
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (uint64_t)2 << 52) {
+        mantissa = (uint64_t)1 << 52;
+        ++power2;
+    }
+    if (power2 >= 0x7FF)
+        return 0x7FF0000000000000;
+    return (mantissa & ~((uint64_t)1 << 52)) | (uint64_t)power2 << 52;
+}
+
+// strtod in the C locale, whatever setlocale has made the current one, so
+// that the decimal point is always '.'.
+static double strtodC(const char *s) {
+    static const locale_t c = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+    return c ? strtod_l(s, nullptr, c) : strtod(s, nullptr);
+}
+
+// Parses the number at s, consuming exactly what the grammar in jsonParse
+// accepts: an optional minus, digits, an optional fraction and an optional
+// exponent, any of whose digit runs may be empty. Tokens without fraction
+// or exponent that fit int64_t become JSON_INTEGER, stored inline when they
+// fit the payload and boxed in the allocator otherwise; returns false only
+// if that allocation fails. Everything else, including -0, becomes the
+// nearest double. Mantissas longer than 19 significant digits are
+// truncated and fall back to strtodC only if the dropped digits could
+// change the rounding.
+// limit bounds the digit loads, as in parseDigits.
+static bool string2number(char *s, const char *limit, char **endptr, JsonValue &value, JsonAllocator &allocator) {
+    char *number = s;
+    bool negative = *s == '-';
+    if (negative)
         ++s;
 
-        double fraction = 1;
-        while (isdigit(*s)) {
-            fraction *= 0.1;
-            result += (*s++ - '0') * fraction;
+    uint64_t mantissa = 0;
+    char *integer = s;
+    s = parseDigits(s, limit, mantissa);
+    int64_t digits = s - integer;
+    int64_t exponent = 0;
+
+    if (*s != '.' && *s != 'e' && *s != 'E' && digits <= 19 && mantissa <= (uint64_t)INT64_MAX + negative &&
+        (mantissa || !negative)) {
+        *endptr = s;
+        int64_t n = negative ? (int64_t)(0 - mantissa) : (int64_t)mantissa;
+        if (n >= -((int64_t)1 << 46) && n < ((int64_t)1 << 46)) {
+            value = JsonValue(JSON_INTEGER, (void *)(uintptr_t)((uint64_t)n & JSON_VALUE_PAYLOAD_MASK));
+            return true;
         }
+        int64_t *box = (int64_t *)allocator.allocate(sizeof(int64_t));
+        if (!box)
+            return false;
+        *box = n;
+        value = JsonValue(JSON_INTEGER | JSON_VALUE_BOXED, box);
+        return true;
+    }
+
+    if (*s == '.') {
+        char *fraction = ++s;
+        s = parseDigits(s, limit, mantissa);
+        exponent = fraction - s;
+        digits += s - fraction;
     }
 
     if (*s == 'e' || *s == 'E') {
         ++s;
 
-        double base = 10;
+        bool negativeExponent = false;
         if (*s == '+')
             ++s;
         else if (*s == '-') {
             ++s;
-            base = 0.1;
+            negativeExponent = true;
         }
 
-        unsigned int exponent = 0;
-        while (isdigit(*s))
-            exponent = (exponent * 10) + (*s++ - '0');
+        int64_t e = 0;
+        for (; isdigit(*s); ++s)
+            if (e < 0x10000000)
+                e = (e * 10) + (*s - '0');
+        exponent += negativeExponent ? -e : e;
+    }
 
-        double power = 1;
-        for (; exponent; exponent >>= 1, base *= base)
-            if (exponent & 1)
-                power *= base;
+    *endptr = s;
 
-        result *= power;
+    bool truncated = false;
+    if (digits > 19) {
+        char *p = integer;
+        for (; p < s && (*p == '0' || *p == '.'); ++p)
+            digits -= *p == '0';
+        if (digits > 19) {
+            truncated = true;
+            mantissa = 0;
+            for (int kept = 0; kept < 19; ++p) {
+                if (*p != '.') {
+                    mantissa = (mantissa * 10) + (*p - '0');
+                    ++kept;
+                }
+            }
+            exponent += digits - 19;
+        }
     }
 
-    *endptr = s;
-    return ch == '-' ? -result : result;
+    double result;
+#if FLT_EVAL_METHOD == 0
+    // Clinger's fast path: both operands and the operation are exact.
+    static const double kPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (!truncated && exponent >= -22 && exponent <= 22 && mantissa <= (uint64_t)1 << 53) {
+        result = (double)(int64_t)mantissa;
+        result = exponent < 0 ? result / kPow10[-exponent] : result * kPow10[exponent];
+        value = JsonValue(negative ? -result : result);
+        return true;
+    }
+#endif
+    uint64_t bits = decimalToBinary(mantissa, exponent);
+    if (truncated && bits != decimalToBinary(mantissa + 1, exponent)) {
+        value = JsonValue(strtodC(number));
+        return true;
+    }
+    memcpy(&result, &bits, sizeof(result));
+    value = JsonValue(negative ? -result : result);
+    return true;
+}
+
+// The digit load limit for in situ numbers, whose buffer end is unknown:
+// the end of the page, which need not be mapped past the NUL, or none at
+// all under JSON_EXACT_READS.
+static inline const char *inSituLimit(const char *s) {
+#ifdef JSON_EXACT_READS
+    return s;
+#else
+    return (const char *)(((uintptr_t)s | 4095) + 1);
+#endif
 }
 
 static inline JsonNode *insertAfter(JsonNode *tail, JsonNode *node) {
@@ -124,16 +799,20 @@ static inline JsonNode *insertAfter(JsonNode *tail, JsonNode *node) {
     return node;
 }
 
-static inline JsonValue listToValue(JsonTag tag, JsonNode *tail) {
+// flags are ORed into the payload, as JSON_VALUE_KEY_VIEWS.
+static inline JsonValue listToValue(JsonTag tag, JsonNode *tail, uintptr_t flags = 0) {
     if (tail) {
         auto head = tail->next;
         tail->next = nullptr;
-        return JsonValue(tag, head);
+        return JsonValue(tag, (void *)((uintptr_t)head | flags));
     }
-    return JsonValue(tag, nullptr);
+    return JsonValue(tag, (void *)flags);
 }
 
-int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator) {
+// Instantiated with and without UTF-8 validation so that the plain parse
+// does not pay for the check.
+template <bool validateUtf8>
+static int parseInSitu(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator) {
     JsonNode *tails[JSON_STACK_SIZE];
     JsonTag tags[JSON_STACK_SIZE];
     char *keys[JSON_STACK_SIZE];
@@ -144,10 +823,7 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
     *endptr = s;
 
     while (*s) {
-        while (isspace(*s)) {
-            ++s;
-            if (!*s) break;
-        }
+        s = skipSpace(s);
         *endptr = s++;
         switch (**endptr) {
         case '-':
@@ -165,7 +841,8 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
         case '7':
         case '8':
         case '9':
-            o = JsonValue(string2double(*endptr, &s));
+            if (!string2number(*endptr, inSituLimit(*endptr), &s, o, allocator))
+                return JSON_ALLOCATION_FAILURE;
             if (!isdelim(*s)) {
                 *endptr = s;
                 return JSON_BAD_NUMBER;
@@ -174,6 +851,20 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
         case '"':
             o = JsonValue(JSON_STRING, s);
             for (char *it = s; *s; ++it, ++s) {
+                const char *bad;
+                size_t run = validateUtf8 ? checkedStringRun(s, bad) : stringRun(s);
+                if (validateUtf8 && bad) {
+                    *endptr = (char *)bad;
+                    return JSON_BAD_UTF8;
+                }
+                if (run) {
+                    if (it != s)
+                        memmove(it, s, run);
+                    it += run;
+                    s += run;
+                    if (!*s)
+                        break;
+                }
                 int c = *it = *s;
                 if (c == '\\') {
                     c = *++s;
@@ -298,6 +989,8 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
             separator = true;
             continue;
         case '\0':
+            // Whitespace before the terminator; stop at it.
+            --s;
             continue;
         default:
             return JSON_UNEXPECTED_CHARACTER;
@@ -324,7 +1017,7 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
             tails[pos]->key = keys[pos];
             keys[pos] = nullptr;
         } else {
-            if ((node = (JsonNode *) allocator.allocate(sizeof(JsonNode) - sizeof(char *))) == nullptr)
+            if ((node = (JsonNode *) allocator.allocate(JSON_ARRAY_NODE_SIZE)) == nullptr)
                 return JSON_ALLOCATION_FAILURE;
             tails[pos] = insertAfter(tails[pos], node);
         }
@@ -332,3 +1025,1486 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
     }
     return JSON_BREAKING_BAD;
 }
+
+int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator, bool validateUtf8) {
+    if (validateUtf8)
+        return parseInSitu<true>(s, endptr, value, allocator);
+    return parseInSitu<false>(s, endptr, value, allocator);
+}
+
+static inline bool isnumberchar(char c) {
+    return isdigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// string2number reads up to the first byte that cannot continue a number,
+// so it stays within the buffer unless the token runs up to end, which is
+// only possible when the buffer ends in a number character. Such a token
+// is parsed from a NUL-terminated copy instead.
+static inline bool viewNumber(const char *s, const char *end, bool numberAtEnd, const char **endptr, JsonValue &value,
+                              JsonAllocator &allocator) {
+    char *e;
+    if (numberAtEnd) {
+        const char *p = s;
+        while (p < end && isnumberchar(*p))
+            ++p;
+        if (p == end) {
+            char local[64];
+            size_t n = end - s;
+            char *copy = n < sizeof(local) ? local : (char *)allocator.allocate(n + 1);
+            if (copy == nullptr)
+                return false;
+            memcpy(copy, s, n);
+            copy[n] = 0;
+            if (!string2number(copy, copy + n + 1, &e, value, allocator))
+                return false;
+            *endptr = s + (e - copy);
+            return true;
+        }
+    }
+    if (!string2number((char *)s, end, &e, value, allocator))
+        return false;
+    *endptr = e;
+    return true;
+}
+
+static inline int escapeValue(const char *hex) {
+    int c = 0;
+    for (int i = 0; i < 4; ++i)
+        c = c * 16 + char2int(hex[i]);
+    return c;
+}
+
+static inline char *encodeEscape(char *it, int c) {
+    if (c < 0x80) {
+        *it++ = c;
+    } else if (c < 0x800) {
+        *it++ = 0xC0 | (c >> 6);
+        *it++ = 0x80 | (c & 0x3F);
+    } else {
+        *it++ = 0xE0 | (c >> 12);
+        *it++ = 0x80 | ((c >> 6) & 0x3F);
+        *it++ = 0x80 | (c & 0x3F);
+    }
+    return it;
+}
+
+// Decodes the string body between p and end into it and returns the end
+// of the output, or nullptr with p at the offending byte if the body holds
+// a bad escape or a control character.
+static char *unescape(const char *&p, const char *end, char *it) {
+    while (p < end) {
+        size_t run = stringRunBounded(p, end);
+        memcpy(it, p, run);
+        it += run;
+        p += run;
+        if (p == end)
+            break;
+        if (*p != '\\' || ++p == end)
+            return nullptr;
+        switch (*p) {
+        case '\\':
+        case '"':
+        case '/':
+            *it++ = *p;
+            break;
+        case 'b':
+            *it++ = '\b';
+            break;
+        case 'f':
+            *it++ = '\f';
+            break;
+        case 'n':
+            *it++ = '\n';
+            break;
+        case 'r':
+            *it++ = '\r';
+            break;
+        case 't':
+            *it++ = '\t';
+            break;
+        case 'u': {
+            int c = 0;
+            for (int i = 0; i < 4; ++i) {
+                if (++p == end || !isxdigit(*p))
+                    return nullptr;
+                c = c * 16 + char2int(*p);
+            }
+            it = encodeEscape(it, c);
+            break;
+        }
+        default:
+            return nullptr;
+        }
+        ++p;
+    }
+    return it;
+}
+
+// Validates the escaped string body at s up to its closing quote and
+// decodes it into scratch behind the length bytes already there while it
+// fits; once it does not, fits is cleared and length just counts. Returns
+// JSON_OK with s at the quote, or JSON_BAD_STRING or JSON_BAD_UTF8 with s
+// at the offending byte, or at end if the body runs past it.
+template <bool validateUtf8>
+static int decodeEscapes(const char *&s, const char *end, char *scratch, size_t capacity, size_t &length,
+                         bool &fits) {
+    while (s < end && *s != '"') {
+        if (*s != '\\' || ++s == end)
+            return JSON_BAD_STRING;
+        int c = *s;
+        switch (c) {
+        case '\\':
+        case '"':
+        case '/':
+            break;
+        case 'b':
+            c = '\b';
+            break;
+        case 'f':
+            c = '\f';
+            break;
+        case 'n':
+            c = '\n';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 't':
+            c = '\t';
+            break;
+        case 'u':
+            for (int i = 0; i < 4; ++i)
+                if (++s == end || !isxdigit(*s))
+                    return JSON_BAD_STRING;
+            c = escapeValue(s - 3);
+            break;
+        default:
+            return JSON_BAD_STRING;
+        }
+        if (fits && length + 3 <= capacity) {
+            length = encodeEscape(scratch + length, c) - scratch;
+        } else {
+            length += c < 0x80 ? 1 : c < 0x800 ? 2 : 3;
+            fits = false;
+        }
+        if (++s < end) {
+            const char *bad = nullptr;
+            size_t run = validateUtf8 ? checkedStringRunBounded(s, end, bad) : stringRunBounded(s, end);
+            if (validateUtf8 && bad) {
+                s = bad;
+                return JSON_BAD_UTF8;
+            }
+            fits = fits && length + run <= capacity;
+            if (fits)
+                memcpy(scratch + length, s, run);
+            s += run;
+            length += run;
+        }
+    }
+    if (s == end)
+        return JSON_BAD_STRING;
+    return JSON_OK;
+}
+
+// Parses the string whose opening quote precedes s into a view and moves s
+// past the closing quote. Plain strings point into the buffer. A string
+// with escapes is validated and decoded into a scratch buffer in one pass
+// and then copied behind its view in the allocator; one too long for the
+// scratch buffer is decoded again from the source instead. On
+// JSON_BAD_STRING and JSON_BAD_UTF8, s is left at the offending byte.
+template <bool validateUtf8>
+static int viewString(const char *&s, const char *end, JsonValue &value, JsonAllocator &allocator) {
+    const char *start = s;
+    const char *bad = nullptr;
+    if (s < end)
+        s += validateUtf8 ? checkedStringRunBounded(s, end, bad) : stringRunBounded(s, end);
+    size_t length = s - start;
+    if (validateUtf8 && bad) {
+        s = bad;
+        return JSON_BAD_UTF8;
+    }
+    JsonStringView *view;
+    if (s < end && *s == '"') {
+        if ((view = (JsonStringView *)allocator.allocate(sizeof(JsonStringView))) == nullptr)
+            return JSON_ALLOCATION_FAILURE;
+        view->data = start;
+        view->length = length;
+        ++s;
+        value = JsonValue(JSON_STRING | JSON_VALUE_BOXED, view);
+        return JSON_OK;
+    }
+
+    char scratch[256];
+    bool fits = length <= sizeof(scratch);
+    if (fits)
+        memcpy(scratch, start, length);
+    int status = decodeEscapes<validateUtf8>(s, end, scratch, sizeof(scratch), length, fits);
+    if (status != JSON_OK)
+        return status;
+
+    if ((view = (JsonStringView *)allocator.allocate(sizeof(JsonStringView) + length)) == nullptr)
+        return JSON_ALLOCATION_FAILURE;
+    char *data = (char *)(view + 1);
+    if (fits)
+        memcpy(data, scratch, length);
+    else
+        unescape(start, s, data);
+    view->data = data;
+    view->length = length;
+    ++s;
+    value = JsonValue(JSON_STRING | JSON_VALUE_BOXED, view);
+    return JSON_OK;
+}
+
+// The same grammar and error codes as the in situ parser, with every read
+// bounded by end. A NUL byte is an unexpected character rather than the
+// end of input, and an unterminated string is a bad string.
+template <bool validateUtf8>
+static int parseView(const char *s, size_t length, const char **endptr, JsonValue *value, JsonAllocator &allocator) {
+    const char *end = s + length;
+    bool numberAtEnd = length && isnumberchar(end[-1]);
+    JsonNode *tails[JSON_STACK_SIZE];
+    JsonTag tags[JSON_STACK_SIZE];
+    const JsonStringView *keys[JSON_STACK_SIZE];
+    JsonValue o;
+    int pos = -1;
+    bool separator = true;
+    JsonNode *node;
+    int status;
+    *endptr = s;
+
+    while (s < end) {
+        s = skipSpaceBounded(s, end);
+        *endptr = s;
+        if (s++ == end)
+            break;
+        switch (**endptr) {
+        case '-':
+            if (s == end || (!isdigit(*s) && *s != '.')) {
+                *endptr = s;
+                return JSON_BAD_NUMBER;
+            }
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+            if (!viewNumber(*endptr, end, numberAtEnd, &s, o, allocator))
+                return JSON_ALLOCATION_FAILURE;
+            if (s < end && !isdelim(*s)) {
+                *endptr = s;
+                return JSON_BAD_NUMBER;
+            }
+            break;
+        case '"':
+            if ((status = viewString<validateUtf8>(s, end, o, allocator)) != JSON_OK) {
+                if (status == JSON_BAD_STRING || status == JSON_BAD_UTF8)
+                    *endptr = s;
+                return status;
+            }
+            if (s < end && !isdelim(*s)) {
+                *endptr = s;
+                return JSON_BAD_STRING;
+            }
+            break;
+        case 't':
+            if (!(end - s >= 3 && s[0] == 'r' && s[1] == 'u' && s[2] == 'e' && (end - s == 3 || isdelim(s[3]))))
+                return JSON_BAD_IDENTIFIER;
+            o = JsonValue(JSON_TRUE);
+            s += 3;
+            break;
+        case 'f':
+            if (!(end - s >= 4 && s[0] == 'a' && s[1] == 'l' && s[2] == 's' && s[3] == 'e' &&
+                  (end - s == 4 || isdelim(s[4]))))
+                return JSON_BAD_IDENTIFIER;
+            o = JsonValue(JSON_FALSE);
+            s += 4;
+            break;
+        case 'n':
+            if (!(end - s >= 3 && s[0] == 'u' && s[1] == 'l' && s[2] == 'l' && (end - s == 3 || isdelim(s[3]))))
+                return JSON_BAD_IDENTIFIER;
+            o = JsonValue(JSON_NULL);
+            s += 3;
+            break;
+        case ']':
+            if (pos == -1)
+                return JSON_STACK_UNDERFLOW;
+            if (tags[pos] != JSON_ARRAY)
+                return JSON_MISMATCH_BRACKET;
+            o = listToValue(JSON_ARRAY, tails[pos--]);
+            break;
+        case '}':
+            if (pos == -1)
+                return JSON_STACK_UNDERFLOW;
+            if (tags[pos] != JSON_OBJECT)
+                return JSON_MISMATCH_BRACKET;
+            if (keys[pos] != nullptr)
+                return JSON_UNEXPECTED_CHARACTER;
+            o = listToValue(JSON_OBJECT, tails[pos--], JSON_VALUE_KEY_VIEWS);
+            break;
+        case '[':
+            if (++pos == JSON_STACK_SIZE)
+                return JSON_STACK_OVERFLOW;
+            tails[pos] = nullptr;
+            tags[pos] = JSON_ARRAY;
+            keys[pos] = nullptr;
+            separator = true;
+            continue;
+        case '{':
+            if (++pos == JSON_STACK_SIZE)
+                return JSON_STACK_OVERFLOW;
+            tails[pos] = nullptr;
+            tags[pos] = JSON_OBJECT;
+            keys[pos] = nullptr;
+            separator = true;
+            continue;
+        case ':':
+            if (separator || keys[pos] == nullptr)
+                return JSON_UNEXPECTED_CHARACTER;
+            separator = true;
+            continue;
+        case ',':
+            if (separator || keys[pos] != nullptr)
+                return JSON_UNEXPECTED_CHARACTER;
+            separator = true;
+            continue;
+        default:
+            return JSON_UNEXPECTED_CHARACTER;
+        }
+
+        separator = false;
+
+        if (pos == -1) {
+            *endptr = s;
+            *value = o;
+            return JSON_OK;
+        }
+
+        if (tags[pos] == JSON_OBJECT) {
+            if (!keys[pos]) {
+                if (o.getTag() != JSON_STRING)
+                    return JSON_UNQUOTED_KEY;
+                keys[pos] = (const JsonStringView *)o.getPayload();
+                continue;
+            }
+            if ((node = (JsonNode *) allocator.allocate(sizeof(JsonNode))) == nullptr)
+                return JSON_ALLOCATION_FAILURE;
+            tails[pos] = insertAfter(tails[pos], node);
+            tails[pos]->keyView = keys[pos];
+            keys[pos] = nullptr;
+        } else {
+            if ((node = (JsonNode *) allocator.allocate(JSON_ARRAY_NODE_SIZE)) == nullptr)
+                return JSON_ALLOCATION_FAILURE;
+            tails[pos] = insertAfter(tails[pos], node);
+        }
+        tails[pos]->value = o;
+    }
+    return JSON_BREAKING_BAD;
+}
+
+int jsonParse(const char *s, size_t length, const char **endptr, JsonValue *value, JsonAllocator &allocator,
+              bool validateUtf8) {
+    if (validateUtf8)
+        return parseView<true>(s, length, endptr, value, allocator);
+    return parseView<false>(s, length, endptr, value, allocator);
+}
+
+// A batch is parsed the same way over both kinds of buffer; these differ
+// only in how one document is parsed and how a line is cut off.
+static inline int parseDocument(char *s, char *, char **endptr, JsonValue *value, JsonAllocator &allocator,
+                                bool validateUtf8) {
+    return jsonParse(s, endptr, value, allocator, validateUtf8);
+}
+
+static inline int parseDocument(const char *s, const char *end, const char **endptr, JsonValue *value,
+                                JsonAllocator &allocator, bool validateUtf8) {
+    return jsonParse(s, end - s, endptr, value, allocator, validateUtf8);
+}
+
+static inline void endLine(char *newline) {
+    *newline = '\0';
+}
+
+static inline void endLine(const char *) {
+}
+
+template <typename Char>
+static size_t parseBatch(Char *str, size_t length, JsonAllocator &allocator, JsonBatchFn callback, void *context,
+                         int flags) {
+    Char *end = str + length;
+    bool lines = !(flags & JSON_BATCH_MULTILINE);
+    JsonDocument document;
+    document.index = 0;
+    for (Char *s = str; s < end; ++s) {
+        Char *lineEnd = lines ? (Char *)memchr(s, '\n', end - s) : nullptr;
+        if (lineEnd)
+            endLine(lineEnd);
+        else
+            lineEnd = end;
+        while (s < lineEnd && (s = (Char *)skipSpaceBounded(s, lineEnd)) < lineEnd) {
+            if (!(flags & JSON_BATCH_KEEP_VALUES))
+                allocator.reset();
+            Char *endptr;
+            document.offset = s - str;
+            document.status = parseDocument(s, lineEnd, &endptr, &document.value, allocator,
+                                            flags & JSON_BATCH_VALIDATE_UTF8);
+            document.errorOffset = document.status == JSON_OK ? 0 : endptr - str;
+            if (document.status != JSON_OK)
+                document.value = JsonValue();
+            if (!callback(context, document))
+                return document.index + 1;
+            ++document.index;
+            if (document.status != JSON_OK) {
+                if (!lines)
+                    return document.index;
+                break;
+            }
+            s = endptr;
+        }
+        s = lineEnd;
+    }
+    return document.index;
+}
+
+size_t jsonParseBatch(char *str, size_t length, JsonAllocator &allocator, JsonBatchFn callback, void *context,
+                      int flags) {
+    return parseBatch(str, length, allocator, callback, context, flags);
+}
+
+size_t jsonParseBatch(const char *str, size_t length, JsonAllocator &allocator, JsonBatchFn callback, void *context,
+                      int flags) {
+    return parseBatch(str, length, allocator, callback, context, flags);
+}
+
+// Returns the closing quote of the string body starting at s, or end if
+// the body runs past it; escape is set if it ends in the middle of one.
+static const char *scanString(const char *s, const char *end, bool &escape) {
+    escape = false;
+    while (s < end) {
+        s += stringRunBounded(s, end);
+        if (s == end)
+            break;
+        if (*s == '"')
+            return s;
+        if (*s == '\\' && ++s == end) {
+            escape = true;
+            break;
+        }
+        ++s;
+    }
+    return end;
+}
+
+// A number or literal runs up to the next delimiter, as in jsonParse.
+static inline const char *scanScalar(const char *s, const char *end) {
+    while (s < end && !isdelim(*s))
+        ++s;
+    return s;
+}
+
+JsonPushParser::~JsonPushParser() {
+    free(pending);
+}
+
+void JsonPushParser::reset() {
+    pos = -1;
+    separator = true;
+    done = false;
+    stringEnded = false;
+    root = JsonValue();
+    status = JSON_OK;
+    chunkOffset = 0;
+    errorOffset = 0;
+    pendingKind = PENDING_NONE;
+    pendingSize = 0;
+    pendingEscape = false;
+}
+
+int JsonPushParser::fail(int error, size_t offset) {
+    status = error;
+    errorOffset = offset;
+    return error;
+}
+
+// Keeps a NUL after the bytes, so that a pending number ends there.
+bool JsonPushParser::appendPending(const char *data, size_t size) {
+    if (pendingSize + size + 1 > pendingCapacity) {
+        size_t capacity = pendingCapacity ? pendingCapacity : 64;
+        while (capacity < pendingSize + size + 1)
+            capacity *= 2;
+        char *grown = (char *)realloc(pending, capacity);
+        if (grown == nullptr)
+            return false;
+        pending = grown;
+        pendingCapacity = capacity;
+    }
+    memcpy(pending + pendingSize, data, size);
+    pendingSize += size;
+    pending[pendingSize] = 0;
+    return true;
+}
+
+int JsonPushParser::string(const char *body, const char *quote, size_t offset) {
+    char *copy = (char *)allocator.allocate(quote - body + 1);
+    if (copy == nullptr)
+        return fail(JSON_ALLOCATION_FAILURE, offset - 1);
+    const char *p = body;
+    char *it = unescape(p, quote, copy);
+    if (it == nullptr)
+        return fail(JSON_BAD_STRING, offset + (p - body));
+    *it = 0;
+    stringEnded = true;
+    return push(JsonValue(JSON_STRING, copy), offset - 1);
+}
+
+// Parses the number or literal at token, which ends at a delimiter inside
+// the chunk or at the NUL after the pending bytes, and returns its end;
+// nullptr on error. As in jsonParse, literals are compared byte by byte so
+// that no read goes past the delimiter; end is that of the chunk or of the
+// pending bytes and their NUL, and bounds the digit loads.
+const char *JsonPushParser::scalar(const char *token, const char *end, size_t offset) {
+    const char *s = token + 1;
+    JsonValue o;
+    switch (*token) {
+    case 't':
+        if (!(s[0] == 'r' && s[1] == 'u' && s[2] == 'e' && isdelim(s[3]))) {
+            fail(JSON_BAD_IDENTIFIER, offset);
+            return nullptr;
+        }
+        o = JsonValue(JSON_TRUE);
+        s += 3;
+        break;
+    case 'f':
+        if (!(s[0] == 'a' && s[1] == 'l' && s[2] == 's' && s[3] == 'e' && isdelim(s[4]))) {
+            fail(JSON_BAD_IDENTIFIER, offset);
+            return nullptr;
+        }
+        o = JsonValue(JSON_FALSE);
+        s += 4;
+        break;
+    case 'n':
+        if (!(s[0] == 'u' && s[1] == 'l' && s[2] == 'l' && isdelim(s[3]))) {
+            fail(JSON_BAD_IDENTIFIER, offset);
+            return nullptr;
+        }
+        o = JsonValue(JSON_NULL);
+        s += 3;
+        break;
+    default:
+        if (*token == '-' && !isdigit(*s) && *s != '.') {
+            fail(JSON_BAD_NUMBER, offset + 1);
+            return nullptr;
+        }
+        char *e;
+        if (!string2number((char *)token, end, &e, o, allocator)) {
+            fail(JSON_ALLOCATION_FAILURE, offset);
+            return nullptr;
+        }
+        s = e;
+        if (!isdelim(*s)) {
+            fail(JSON_BAD_NUMBER, offset + (s - token));
+            return nullptr;
+        }
+        break;
+    }
+    return push(o, offset) == JSON_OK ? s : nullptr;
+}
+
+int JsonPushParser::push(JsonValue o, size_t offset) {
+    separator = false;
+    if (pos == -1) {
+        root = o;
+        done = true;
+        return JSON_OK;
+    }
+    JsonNode *node;
+    if (tags[pos] == JSON_OBJECT) {
+        if (!keys[pos]) {
+            if (o.getTag() != JSON_STRING)
+                return fail(JSON_UNQUOTED_KEY, offset);
+            keys[pos] = o.toString();
+            return JSON_OK;
+        }
+        if ((node = (JsonNode *) allocator.allocate(sizeof(JsonNode))) == nullptr)
+            return fail(JSON_ALLOCATION_FAILURE, offset);
+        tails[pos] = insertAfter(tails[pos], node);
+        tails[pos]->key = keys[pos];
+        keys[pos] = nullptr;
+    } else {
+        if ((node = (JsonNode *) allocator.allocate(JSON_ARRAY_NODE_SIZE)) == nullptr)
+            return fail(JSON_ALLOCATION_FAILURE, offset);
+        tails[pos] = insertAfter(tails[pos], node);
+    }
+    tails[pos]->value = o;
+    return JSON_OK;
+}
+
+// Continues the token cut off by the previous chunk, completing it if its
+// end is in [s, end).
+void JsonPushParser::resume(const char *&s, const char *end) {
+    const char *tokenEnd;
+    if (pendingKind == PENDING_STRING) {
+        const char *from = s;
+        if (pendingEscape)
+            ++from;
+        tokenEnd = from <= end ? scanString(from, end, pendingEscape) : end;
+    } else {
+        tokenEnd = scanScalar(s, end);
+    }
+    if (!appendPending(s, tokenEnd - s)) {
+        fail(JSON_ALLOCATION_FAILURE, pendingOffset);
+        return;
+    }
+    s = tokenEnd;
+    if (tokenEnd == end)
+        return;
+    if (pendingKind == PENDING_STRING) {
+        ++s;
+        string(pending, pending + pendingSize, pendingOffset + 1);
+    } else {
+        scalar(pending, pending + pendingSize + 1, pendingOffset);
+    }
+    pendingKind = PENDING_NONE;
+    pendingSize = 0;
+}
+
+int JsonPushParser::feed(const char *data, size_t size) {
+    const char *s = data;
+    const char *end = data + size;
+    if (status == JSON_OK && pendingKind != PENDING_NONE)
+        resume(s, end);
+    // A scalar that starts before tail ends at a delimiter before it; one
+    // that starts later may be cut off by the end of the chunk.
+    const char *tail = end;
+    while (tail > s && !isdelim(tail[-1]))
+        --tail;
+
+    while (status == JSON_OK && s < end) {
+        if (stringEnded) {
+            stringEnded = false;
+            if (!isdelim(*s)) {
+                fail(JSON_BAD_STRING, chunkOffset + (s - data));
+                break;
+            }
+        }
+        s = skipSpaceBounded(s, end);
+        if (s == end)
+            break;
+        size_t offset = chunkOffset + (s - data);
+        if (done) {
+            fail(JSON_UNEXPECTED_CHARACTER, offset);
+            break;
+        }
+        const char *token = s++;
+        switch (*token) {
+        case '"': {
+            size_t run = s < end ? stringRunBounded(s, end) : 0;
+            if (s + run < end && s[run] == '"') {
+                char *copy = (char *)allocator.allocate(run + 1);
+                if (copy == nullptr) {
+                    fail(JSON_ALLOCATION_FAILURE, offset);
+                    break;
+                }
+                memcpy(copy, s, run);
+                copy[run] = 0;
+                s += run + 1;
+                stringEnded = true;
+                push(JsonValue(JSON_STRING, copy), offset);
+                break;
+            }
+            // Short strings with escapes are decoded in one pass, the rest
+            // are found first and then decoded.
+            if (s + run < end && run <= 256) {
+                char scratch[256];
+                const char *p = s + run;
+                size_t length = run;
+                bool fits = true;
+                memcpy(scratch, s, run);
+                if (decodeEscapes<false>(p, end, scratch, sizeof(scratch), length, fits) == JSON_OK && fits) {
+                    char *copy = (char *)allocator.allocate(length + 1);
+                    if (copy == nullptr) {
+                        fail(JSON_ALLOCATION_FAILURE, offset);
+                        break;
+                    }
+                    memcpy(copy, scratch, length);
+                    copy[length] = 0;
+                    s = p + 1;
+                    stringEnded = true;
+                    push(JsonValue(JSON_STRING, copy), offset);
+                    break;
+                }
+            }
+            bool escape;
+            const char *quote = scanString(s + run, end, escape);
+            if (quote == end) {
+                pendingKind = PENDING_STRING;
+                pendingEscape = escape;
+                pendingOffset = offset;
+                if (!appendPending(s, end - s))
+                    fail(JSON_ALLOCATION_FAILURE, offset);
+                s = end;
+                break;
+            }
+            string(s, quote, offset + 1);
+            s = quote + 1;
+            break;
+        }
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+        case 't':
+        case 'f':
+        case 'n':
+            if (token >= tail) {
+                pendingKind = PENDING_SCALAR;
+                pendingOffset = offset;
+                if (!appendPending(token, end - token))
+                    fail(JSON_ALLOCATION_FAILURE, offset);
+                s = end;
+                break;
+            }
+            s = scalar(token, end, offset);
+            break;
+        case ']':
+            if (pos == -1)
+                fail(JSON_STACK_UNDERFLOW, offset);
+            else if (tags[pos] != JSON_ARRAY)
+                fail(JSON_MISMATCH_BRACKET, offset);
+            else
+                push(listToValue(JSON_ARRAY, tails[pos--]), offset);
+            break;
+        case '}':
+            if (pos == -1)
+                fail(JSON_STACK_UNDERFLOW, offset);
+            else if (tags[pos] != JSON_OBJECT)
+                fail(JSON_MISMATCH_BRACKET, offset);
+            else if (keys[pos] != nullptr)
+                fail(JSON_UNEXPECTED_CHARACTER, offset);
+            else
+                push(listToValue(JSON_OBJECT, tails[pos--]), offset);
+            break;
+        case '[':
+        case '{':
+            if (++pos == JSON_STACK_SIZE) {
+                fail(JSON_STACK_OVERFLOW, offset);
+                break;
+            }
+            tails[pos] = nullptr;
+            tags[pos] = *token == '[' ? JSON_ARRAY : JSON_OBJECT;
+            keys[pos] = nullptr;
+            separator = true;
+            break;
+        case ':':
+            if (separator || keys[pos] == nullptr)
+                fail(JSON_UNEXPECTED_CHARACTER, offset);
+            separator = true;
+            break;
+        case ',':
+            if (separator || keys[pos] != nullptr)
+                fail(JSON_UNEXPECTED_CHARACTER, offset);
+            separator = true;
+            break;
+        default:
+            fail(JSON_UNEXPECTED_CHARACTER, offset);
+            break;
+        }
+    }
+    chunkOffset += size;
+    return status;
+}
+
+int JsonPushParser::finish(JsonValue *value) {
+    if (status == JSON_OK && pendingKind == PENDING_SCALAR) {
+        scalar(pending, pending + pendingSize + 1, pendingOffset);
+        pendingKind = PENDING_NONE;
+        pendingSize = 0;
+    }
+    if (status == JSON_OK && pendingKind == PENDING_STRING) {
+        // Report a bad escape before the missing quote, as jsonParse does.
+        const char *p = pending;
+        char *copy = (char *)allocator.allocate(pendingSize);
+        if (copy && unescape(p, pending + pendingSize, copy) == nullptr)
+            fail(JSON_BAD_STRING, pendingOffset + 1 + (p - pending));
+        else
+            fail(JSON_BAD_STRING, chunkOffset);
+    }
+    if (status == JSON_OK && !done)
+        fail(JSON_BREAKING_BAD, chunkOffset);
+    if (status == JSON_OK)
+        *value = root;
+    return status;
+}
+
+static inline bool iscontainer(JsonValue v) {
+    return v.getTag() == JSON_ARRAY || v.getTag() == JSON_OBJECT;
+}
+
+static inline size_t nodeSize(JsonTag tag) {
+    return tag == JSON_ARRAY ? JSON_ARRAY_NODE_SIZE : sizeof(JsonNode);
+}
+
+// Bytes of the runs for v and every container below it. Recursion is
+// bounded by JSON_STACK_SIZE.
+static size_t compactSize(JsonValue v) {
+    if (!v.toNode())
+        return 0;
+    size_t bytes = sizeof(size_t);
+    for (JsonNode *node = v.toNode(); node; node = node->next)
+        bytes += nodeSize(v.getTag()) + (iscontainer(node->value) ? compactSize(node->value) : 0);
+    return bytes;
+}
+
+// Copies the members of v to a run at out and advances out past it. The
+// copies still point at the original children.
+static JsonValue placeRun(JsonValue v, char *&out) {
+    JsonTag tag = v.getTag();
+    uintptr_t flags = v.getPayload() & JSON_VALUE_KEY_VIEWS;
+    if (!v.toNode())
+        return JsonValue(tag | JSON_VALUE_BOXED, (void *)flags);
+    size_t stride = nodeSize(tag);
+    size_t *header = (size_t *)out;
+    char *p = out + sizeof(size_t);
+    JsonNode *first = (JsonNode *)p;
+    size_t count = 0;
+    for (JsonNode *node = v.toNode(); node; node = node->next, p += stride, ++count) {
+        JsonNode *copy = (JsonNode *)p;
+        copy->value = node->value;
+        copy->next = (JsonNode *)(p + stride);
+        if (tag == JSON_OBJECT)
+            copy->key = node->key;
+    }
+    ((JsonNode *)(p - stride))->next = nullptr;
+    *header = count << 1 | (tag == JSON_OBJECT);
+    out = p;
+    return JsonValue(tag | JSON_VALUE_BOXED, (void *)((uintptr_t)first | flags));
+}
+
+int jsonCompact(JsonValue *value, JsonAllocator &allocator) {
+    if (!iscontainer(*value))
+        return JSON_OK;
+    size_t bytes = compactSize(*value);
+    char *block = bytes ? (char *)allocator.allocate(bytes) : nullptr;
+    if (bytes && !block)
+        return JSON_ALLOCATION_FAILURE;
+
+    // Runs are appended in the order their parents were placed, so the
+    // placed runs themselves serve as the breadth-first queue.
+    char *out = block;
+    JsonValue root = placeRun(*value, out);
+    for (char *scan = block; scan < out;) {
+        size_t header = *(size_t *)scan;
+        size_t stride = header & 1 ? sizeof(JsonNode) : JSON_ARRAY_NODE_SIZE;
+        char *p = scan + sizeof(size_t);
+        scan = p + (header >> 1) * stride;
+        for (; p < scan; p += stride) {
+            JsonNode *node = (JsonNode *)p;
+            if (iscontainer(node->value))
+                node->value = placeRun(node->value, out);
+        }
+    }
+    *value = root;
+    return JSON_OK;
+}
+
+// Both tables are open-addressed with linear probing, at most half full.
+struct JsonIndexSlot {
+    uint64_t hash;
+    JsonNode *node;
+};
+
+struct JsonObjectIndex {
+    size_t mask;
+    JsonIndexSlot slots[1];
+};
+
+struct JsonIndexEntry {
+    const JsonNode *head;
+    JsonObjectIndex *index;
+};
+
+struct JsonIndexMap {
+    size_t count;
+    size_t mask;
+    JsonIndexEntry entries[1];
+};
+
+// FNV-1a; never 0, which marks an empty slot.
+static inline uint64_t hashKey(const char *key) {
+    uint64_t h = 0xCBF29CE484222325;
+    for (; *key; ++key)
+        h = (h ^ (unsigned char)*key) * 0x100000001B3;
+    return h | 1;
+}
+
+static inline size_t hashPointer(const void *p) {
+    return (size_t)(((uint64_t)(uintptr_t)p * 0x9E3779B97F4A7C15) >> 32);
+}
+
+static size_t tableSize(size_t count) {
+    size_t size = 8;
+    while (size < 2 * count)
+        size *= 2;
+    return size;
+}
+
+static JsonObjectIndex *buildIndex(JsonNode *head, JsonAllocator &allocator) {
+    size_t count = 0;
+    for (JsonNode *node = head; node; node = node->next)
+        ++count;
+    size_t size = tableSize(count);
+    auto index = (JsonObjectIndex *)allocator.allocate(sizeof(JsonObjectIndex) + (size - 1) * sizeof(JsonIndexSlot));
+    if (!index)
+        return nullptr;
+    index->mask = size - 1;
+    memset(index->slots, 0, size * sizeof(JsonIndexSlot));
+    for (JsonNode *node = head; node; node = node->next) {
+        uint64_t hash = hashKey(node->key);
+        size_t i = hash & index->mask;
+        for (; index->slots[i].hash; i = (i + 1) & index->mask)
+            if (index->slots[i].hash == hash && !strcmp(index->slots[i].node->key, node->key))
+                break;
+        // Duplicate keys keep their first member, as a scan would.
+        if (!index->slots[i].hash)
+            index->slots[i] = {hash, node};
+    }
+    return index;
+}
+
+static JsonObjectIndex *findIndex(const JsonIndexMap *map, const JsonNode *head) {
+    if (!map)
+        return nullptr;
+    for (size_t i = hashPointer(head) & map->mask; map->entries[i].head; i = (i + 1) & map->mask)
+        if (map->entries[i].head == head)
+            return map->entries[i].index;
+    return nullptr;
+}
+
+static bool addIndex(JsonIndexMap *&map, const JsonNode *head, JsonObjectIndex *index, JsonAllocator &allocator) {
+    if (!map || 2 * (map->count + 1) > map->mask + 1) {
+        // The old table stays in the zones until the next reset.
+        size_t size = tableSize(map ? map->count + 1 : 1);
+        auto grown = (JsonIndexMap *)allocator.allocate(sizeof(JsonIndexMap) + (size - 1) * sizeof(JsonIndexEntry));
+        if (!grown)
+            return false;
+        grown->count = 0;
+        grown->mask = size - 1;
+        memset(grown->entries, 0, size * sizeof(JsonIndexEntry));
+        for (size_t i = 0; map && i <= map->mask; ++i)
+            if (map->entries[i].head)
+                addIndex(grown, map->entries[i].head, map->entries[i].index, allocator);
+        map = grown;
+    }
+    size_t i = hashPointer(head) & map->mask;
+    while (map->entries[i].head)
+        i = (i + 1) & map->mask;
+    map->entries[i] = {head, index};
+    ++map->count;
+    return true;
+}
+
+JsonNode *jsonFind(JsonValue object, const char *key, JsonAllocator &allocator, size_t minWidth) {
+    assert(object.getTag() == JSON_OBJECT && !object.hasKeyViews());
+    JsonNode *head = object.toNode();
+    JsonObjectIndex *index = findIndex(allocator.indexes, head);
+    if (!index) {
+        JsonNode *node = head;
+        for (size_t width = 0; node && width < minWidth; node = node->next, ++width)
+            if (!strcmp(node->key, key))
+                return node;
+        if (!node)
+            return nullptr;
+        index = buildIndex(head, allocator);
+        if (!index || !addIndex(allocator.indexes, head, index, allocator)) {
+            for (; node; node = node->next)
+                if (!strcmp(node->key, key))
+                    return node;
+            return nullptr;
+        }
+    }
+
+    uint64_t hash = hashKey(key);
+    for (size_t i = hash & index->mask; index->slots[i].hash; i = (i + 1) & index->mask)
+        if (index->slots[i].hash == hash && !strcmp(index->slots[i].node->key, key))
+            return index->slots[i].node;
+    return nullptr;
+}
+
+JsonBuffer::~JsonBuffer() {
+    free(data);
+}
+
+// Grisu2 from Loitsch, "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers", in the variant of double-conversion and
+// RapidJSON. The digits always read back to the same double and are the
+// shortest such in all but a tiny fraction of cases.
+struct DiyFp {
+    uint64_t f;
+    int e;
+};
+
+static inline DiyFp normalize(DiyFp x) {
+    int shift = leadingZeros(x.f);
+    return DiyFp{x.f << shift, x.e - shift};
+}
+
+// Rounded product, with the exponent of the high half.
+static inline DiyFp multiply(DiyFp a, DiyFp b) {
+    uint64_t high, low;
+    multiply128(a.f, b.f, high, low);
+    return DiyFp{high + (low >> 63), a.e + b.e + 64};
+}
+
+static const uint64_t kPow10[] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL,
+};
+
+static inline int countDecimalDigits(uint32_t n) {
+    int digits = 1;
+    while (digits < 10 && n >= kPow10[digits])
+        ++digits;
+    return digits;
+}
+
+// Moves the last digit down while that keeps the number inside the
+// rounding interval and brings it closer to the exact value.
+static inline void grisuRound(char *buffer, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa,
+                              uint64_t distance) {
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+        --buffer[length - 1];
+        rest += tenKappa;
+    }
+}
+
+// Emits the digits of high, the upper end of the interval, until what is
+// left is below delta, its width; K is the decimal exponent of the last
+// digit on return.
+static void digitGen(DiyFp w, DiyFp high, uint64_t delta, char *buffer, int &length, int &K) {
+    DiyFp one = {1ULL << -high.e, high.e};
+    uint64_t distance = high.f - w.f;
+    uint32_t p1 = (uint32_t)(high.f >> -one.e);
+    uint64_t p2 = high.f & (one.f - 1);
+    int kappa = countDecimalDigits(p1);
+    length = 0;
+    while (kappa > 0) {
+        uint32_t divisor = (uint32_t)kPow10[kappa - 1];
+        uint32_t digit = p1 / divisor;
+        p1 %= divisor;
+        if (digit || length)
+            buffer[length++] = (char)('0' + digit);
+        --kappa;
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            K += kappa;
+            grisuRound(buffer, length, delta, rest, kPow10[kappa] << -one.e, distance);
+            return;
+        }
+    }
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char digit = (char)(p2 >> -one.e);
+        if (digit || length)
+            buffer[length++] = (char)('0' + digit);
+        p2 &= one.f - 1;
+        --kappa;
+        if (p2 < delta) {
+            K += kappa;
+            grisuRound(buffer, length, delta, p2, one.f, -kappa < 20 ? distance * kPow10[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+// Digits of a positive finite x; x is close to buffer * 10^K.
+static void grisu2(double x, char *buffer, int &length, int &K) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof bits);
+    uint64_t fraction = bits & ((1ULL << 52) - 1);
+    int exponent = (int)(bits >> 52);
+    DiyFp w = exponent ? DiyFp{fraction | 1ULL << 52, exponent - 1075} : DiyFp{fraction, -1074};
+
+    DiyFp high = normalize(DiyFp{(w.f << 1) + 1, w.e - 1});
+    DiyFp low = w.f == 1ULL << 52 ? DiyFp{(w.f << 2) - 1, w.e - 2} : DiyFp{(w.f << 1) - 1, w.e - 1};
+    low.f <<= low.e - high.e;
+    low.e = high.e;
+
+    // The cached power that brings high's exponent into [-60, -32].
+    double dk = (-61 - high.e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if (dk - k > 0)
+        ++k;
+    unsigned index = (unsigned)((k >> 3) + 1);
+    K = -(JSON_POW10_MIN + (int)index * JSON_POW10_STEP);
+    DiyFp c = {kCachedPow10[index].f, kCachedPow10[index].e};
+
+    DiyFp scaled = multiply(normalize(w), c);
+    DiyFp scaledHigh = multiply(high, c);
+    DiyFp scaledLow = multiply(low, c);
+    ++scaledLow.f;
+    --scaledHigh.f;
+    digitGen(scaled, scaledHigh, scaledHigh.f - scaledLow.f, buffer, length, K);
+}
+
+static const char kDigitPairs[] = "00010203040506070809"
+                                  "10111213141516171819"
+                                  "20212223242526272829"
+                                  "30313233343536373839"
+                                  "40414243444546474849"
+                                  "50515253545556575859"
+                                  "60616263646566676869"
+                                  "70717273747576777879"
+                                  "80818283848586878889"
+                                  "90919293949596979899";
+
+static char *writeUnsigned(char *out, uint64_t n) {
+    char digits[20];
+    char *p = digits + sizeof digits;
+    while (n >= 100) {
+        p -= 2;
+        memcpy(p, kDigitPairs + n % 100 * 2, 2);
+        n /= 100;
+    }
+    if (n >= 10) {
+        p -= 2;
+        memcpy(p, kDigitPairs + n * 2, 2);
+    } else {
+        *--p = (char)('0' + n);
+    }
+    size_t size = digits + sizeof digits - p;
+    memcpy(out, p, size);
+    return out + size;
+}
+
+// Lays out length digits times 10^K the way JavaScript does, fixed for
+// decimal exponents from -6 up to 21 and in exponent form beyond, but
+// with ".0" after integers so that they read back as doubles.
+static char *formatDigits(char *out, const char *digits, int length, int K) {
+    int point = length + K;
+    if (K >= 0 && point <= 21) {
+        memcpy(out, digits, length);
+        memset(out + length, '0', K);
+        out += point;
+        *out++ = '.';
+        *out++ = '0';
+    } else if (point > 0 && point <= 21) {
+        memcpy(out, digits, point);
+        out[point] = '.';
+        memcpy(out + point + 1, digits + point, length - point);
+        out += length + 1;
+    } else if (point > -6 && point <= 0) {
+        *out++ = '0';
+        *out++ = '.';
+        memset(out, '0', -point);
+        memcpy(out - point, digits, length);
+        out += length - point;
+    } else {
+        *out++ = digits[0];
+        if (length > 1) {
+            *out++ = '.';
+            memcpy(out, digits + 1, length - 1);
+            out += length - 1;
+        }
+        *out++ = 'e';
+        int exponent = point - 1;
+        if (exponent < 0) {
+            *out++ = '-';
+            exponent = -exponent;
+        }
+        out = writeUnsigned(out, (uint64_t)exponent);
+    }
+    return out;
+}
+
+// Room for the longest double, "-0.00000" and 17 digits.
+#define JSON_DOUBLE_SIZE 32
+
+static char *writeDouble(char *out, double x) {
+    if (x - x != 0) {
+        memcpy(out, "null", 4);
+        return out + 4;
+    }
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof bits);
+    if (bits >> 63) {
+        *out++ = '-';
+        x = -x;
+    }
+    if (x == 0) {
+        memcpy(out, "0.0", 3);
+        return out + 3;
+    }
+    char digits[20];
+    int length, K;
+    grisu2(x, digits, length, K);
+    return formatDigits(out, digits, length, K);
+}
+
+// Output state of one jsonWrite call: [cur, limit) is the free part of
+// either the caller's JsonBuffer or local, which goes to write when full.
+struct JsonOutput {
+    char *cur;
+    char *limit;
+    JsonBuffer *buffer;
+    JsonWriteFn write;
+    void *context;
+    int indent;
+    int status = JSON_OK;
+    char local[4096];
+
+    bool refill(size_t size);
+    // Makes room for size bytes, at most sizeof(local).
+    bool reserve(size_t size) {
+        return (size_t)(limit - cur) >= size || refill(size);
+    }
+    bool put(char c) {
+        if (!reserve(1))
+            return false;
+        *cur++ = c;
+        return true;
+    }
+    bool append(const char *data, size_t size);
+    bool escape(char c);
+    bool newline(int depth);
+    bool string(const char *s);
+    bool string(const char *s, size_t length);
+    bool value(JsonValue v, int depth);
+    int finish();
+};
+
+bool JsonOutput::refill(size_t size) {
+    if (buffer) {
+        buffer->size = cur - buffer->data;
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : sizeof(local);
+        if (capacity < buffer->size + size)
+            capacity = buffer->size + size;
+        char *data = (char *)realloc(buffer->data, capacity);
+        if (!data) {
+            status = JSON_ALLOCATION_FAILURE;
+            return false;
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+        cur = data + buffer->size;
+        limit = data + capacity;
+        return true;
+    }
+    if (cur != local && !write(context, local, cur - local)) {
+        status = JSON_WRITE_FAILURE;
+        return false;
+    }
+    cur = local;
+    return true;
+}
+
+bool JsonOutput::append(const char *data, size_t size) {
+    while (size) {
+        if (cur == limit && !refill(1))
+            return false;
+        size_t n = (size_t)(limit - cur) < size ? limit - cur : size;
+        memcpy(cur, data, n);
+        cur += n;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool JsonOutput::escape(char c) {
+    if (!reserve(6))
+        return false;
+    *cur++ = '\\';
+    switch (c) {
+    case '"':
+    case '\\':
+        *cur++ = c;
+        break;
+    case '\b':
+        *cur++ = 'b';
+        break;
+    case '\f':
+        *cur++ = 'f';
+        break;
+    case '\n':
+        *cur++ = 'n';
+        break;
+    case '\r':
+        *cur++ = 'r';
+        break;
+    case '\t':
+        *cur++ = 't';
+        break;
+    default:
+        memcpy(cur, "u00", 3);
+        cur[3] = "0123456789ABCDEF"[(unsigned char)c >> 4];
+        cur[4] = "0123456789ABCDEF"[c & 15];
+        cur += 5;
+    }
+    return true;
+}
+
+bool JsonOutput::newline(int depth) {
+    if (!put('\n'))
+        return false;
+    for (size_t spaces = (size_t)indent * depth; spaces;) {
+        if (cur == limit && !refill(1))
+            return false;
+        size_t n = (size_t)(limit - cur) < spaces ? limit - cur : spaces;
+        memset(cur, ' ', n);
+        cur += n;
+        spaces -= n;
+    }
+    return true;
+}
+
+// Strings parsed in situ end at their NUL, which the scanner stops at
+// like at any other control character, so they need no strlen.
+bool JsonOutput::string(const char *s) {
+    if (!put('"'))
+        return false;
+    for (;;) {
+        size_t run = stringRun(s);
+        if (!append(s, run))
+            return false;
+        s += run;
+        if (!*s)
+            break;
+        if (!escape(*s++))
+            return false;
+    }
+    return put('"');
+}
+
+bool JsonOutput::string(const char *s, size_t length) {
+    const char *end = s + length;
+    if (!put('"'))
+        return false;
+    while (s < end) {
+        size_t run = stringRunBounded(s, end);
+        if (!append(s, run))
+            return false;
+        s += run;
+        if (s < end && !escape(*s++))
+            return false;
+    }
+    return put('"');
+}
+
+bool JsonOutput::value(JsonValue v, int depth) {
+    switch (v.getTag()) {
+    case JSON_NUMBER:
+        if (!reserve(JSON_DOUBLE_SIZE))
+            return false;
+        cur = writeDouble(cur, v.toNumber());
+        return true;
+    case JSON_INTEGER: {
+        if (!reserve(20))
+            return false;
+        int64_t n = v.toInteger();
+        if (n < 0)
+            *cur++ = '-';
+        cur = writeUnsigned(cur, n < 0 ? 0 - (uint64_t)n : (uint64_t)n);
+        return true;
+    }
+    case JSON_STRING:
+        if (v.isView()) {
+            JsonStringView view = v.toStringView();
+            return string(view.data, view.length);
+        }
+        return string(v.toString());
+    case JSON_ARRAY:
+    case JSON_OBJECT: {
+        bool object = v.getTag() == JSON_OBJECT;
+        bool keyViews = object && v.hasKeyViews();
+        if (!put(object ? '{' : '['))
+            return false;
+        JsonNode *node = v.toNode();
+        for (JsonNode *i = node; i; i = i->next) {
+            if (i != node && !put(','))
+                return false;
+            if (indent && !newline(depth + 1))
+                return false;
+            if (object) {
+                if (!(keyViews ? string(i->keyView->data, i->keyView->length) : string(i->key)))
+                    return false;
+                if (!put(':') || (indent && !put(' ')))
+                    return false;
+            }
+            if (!value(i->value, depth + 1))
+                return false;
+        }
+        if (node && indent && !newline(depth))
+            return false;
+        return put(object ? '}' : ']');
+    }
+    case JSON_TRUE:
+        return append("true", 4);
+    case JSON_FALSE:
+        return append("false", 5);
+    case JSON_NULL:
+        return append("null", 4);
+    }
+    return true;
+}
+
+int JsonOutput::finish() {
+    if (buffer)
+        buffer->size = cur - buffer->data;
+    else if (status == JSON_OK && cur != local && !write(context, local, cur - local))
+        status = JSON_WRITE_FAILURE;
+    return status;
+}
+
+int jsonWrite(JsonValue value, JsonBuffer &buffer, int indent) {
+    JsonOutput out;
+    out.cur = buffer.data + buffer.size;
+    out.limit = buffer.data + buffer.capacity;
+    out.buffer = &buffer;
+    out.indent = indent;
+    out.value(value, 0);
+    return out.finish();
+}
+
+int jsonWrite(JsonValue value, JsonWriteFn write, void *context, int indent) {
+    JsonOutput out;
+    out.cur = out.local;
+    out.limit = out.local + sizeof(out.local);
+    out.buffer = nullptr;
+    out.write = write;
+    out.context = context;
+    out.indent = indent;
+    out.value(value, 0);
+    return out.finish();
+}
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <assert.h>
+#include <string.h>
 
 enum JsonTag {
     JSON_NUMBER = 0,
@@ -11,15 +12,34 @@ enum JsonTag {
     JSON_OBJECT,
     JSON_TRUE,
     JSON_FALSE,
-    JSON_NULL = 0xF
+    JSON_INTEGER,
+    // Was 0xF before JSON_VALUE_BOXED took the top tag bit.
+    JSON_NULL = 0x7
 };
 
 struct JsonNode;
 
 #define JSON_VALUE_PAYLOAD_MASK 0x00007FFFFFFFFFFFULL
 #define JSON_VALUE_NAN_MASK 0x7FF8000000000000ULL
-#define JSON_VALUE_TAG_MASK 0xF
+#define JSON_VALUE_TAG_MASK 0x7
 #define JSON_VALUE_TAG_SHIFT 47
+// Added to JSON_INTEGER when the payload points to an int64_t in the
+// allocator's zones rather than holding a 47-bit two's complement value,
+// to JSON_STRING when it points to a JsonStringView, and to JSON_ARRAY and
+// JSON_OBJECT laid out by jsonCompact.
+#define JSON_VALUE_BOXED 0x8
+// Set in the payload of objects from the const-buffer jsonParse, whose
+// members have keyView rather than key. Nodes are 8-byte aligned, so the
+// low bits of a node pointer are free.
+#define JSON_VALUE_KEY_VIEWS 0x1
+
+// A string parsed from a const buffer. data points into the buffer, or
+// into the allocator for strings that had escapes, and is not
+// NUL-terminated.
+struct JsonStringView {
+    const char *data;
+    size_t length;
+};
 
 union JsonValue {
     uint64_t ival;
@@ -28,9 +48,15 @@ union JsonValue {
     JsonValue(double x)
         : fval(x) {
     }
-    JsonValue(JsonTag tag = JSON_NULL, void *payload = nullptr) {
+    JsonValue(JsonTag tag = JSON_NULL, void *payload = nullptr)
+        : JsonValue((uint64_t)tag, payload) {
+    }
+    // tagBits is a JsonTag, plus JSON_VALUE_BOXED for the forms it marks;
+    // those bits are not valid JsonTag values themselves.
+    JsonValue(uint64_t tagBits, void *payload) {
+        assert(tagBits <= (JSON_VALUE_TAG_MASK | JSON_VALUE_BOXED));
         assert((uint64_t)payload <= JSON_VALUE_PAYLOAD_MASK);
-        ival = JSON_VALUE_NAN_MASK | ((uint64_t)tag << JSON_VALUE_TAG_SHIFT) | (uintptr_t)payload;
+        ival = JSON_VALUE_NAN_MASK | (tagBits << JSON_VALUE_TAG_SHIFT) | (uintptr_t)payload;
     }
     bool isDouble() const {
         return (int64_t)ival <= (int64_t)JSON_VALUE_NAN_MASK;
@@ -38,30 +64,81 @@ union JsonValue {
     JsonTag getTag() const {
         return isDouble() ? JSON_NUMBER : JsonTag((ival >> JSON_VALUE_TAG_SHIFT) & JSON_VALUE_TAG_MASK);
     }
+    // JSON_NUMBER or JSON_INTEGER, either of which toNumber reads.
+    bool isNumber() const {
+        return isDouble() || getTag() == JSON_INTEGER;
+    }
     uint64_t getPayload() const {
         assert(!isDouble());
         return ival & JSON_VALUE_PAYLOAD_MASK;
     }
+    int64_t toInteger() const {
+        assert(getTag() == JSON_INTEGER);
+        if ((ival >> JSON_VALUE_TAG_SHIFT) & JSON_VALUE_BOXED)
+            return *(const int64_t *)getPayload();
+        return (int64_t)(ival << (64 - JSON_VALUE_TAG_SHIFT)) >> (64 - JSON_VALUE_TAG_SHIFT);
+    }
     double toNumber() const {
-        assert(getTag() == JSON_NUMBER);
-        return fval;
+        assert(isNumber());
+        return isDouble() ? fval : (double)toInteger();
     }
-    char *toString() const {
+    bool isView() const {
         assert(getTag() == JSON_STRING);
+        return (ival >> JSON_VALUE_TAG_SHIFT) & JSON_VALUE_BOXED;
+    }
+    // Strings parsed in situ only.
+    char *toString() const {
+        assert(getTag() == JSON_STRING && !isView());
         return (char *)getPayload();
     }
+    JsonStringView toStringView() const {
+        if (isView())
+            return *(const JsonStringView *)getPayload();
+        return JsonStringView{toString(), strlen(toString())};
+    }
     JsonNode *toNode() const {
         assert(getTag() == JSON_ARRAY || getTag() == JSON_OBJECT);
-        return (JsonNode *)getPayload();
+        return (JsonNode *)(getPayload() & ~(uint64_t)JSON_VALUE_KEY_VIEWS);
+    }
+    bool hasKeyViews() const {
+        assert(getTag() == JSON_OBJECT);
+        return getPayload() & JSON_VALUE_KEY_VIEWS;
+    }
+    bool isCompact() const {
+        assert(getTag() == JSON_ARRAY || getTag() == JSON_OBJECT);
+        return (ival >> JSON_VALUE_TAG_SHIFT) & JSON_VALUE_BOXED;
     }
+    // Compact containers only.
+    size_t getLength() const;
+    JsonNode *at(size_t i) const;
 };
 
 struct JsonNode {
     JsonValue value;
     JsonNode *next;
-    char *key;
+    union {
+        char *key;
+        // Members of objects parsed from a const buffer.
+        const JsonStringView *keyView;
+    };
 };
 
+// Array members have no key, in lists and compact runs alike.
+#define JSON_ARRAY_NODE_SIZE (sizeof(JsonNode) - sizeof(char *))
+
+// A compact run is a size_t holding the member count shifted left by one,
+// with the low bit set for objects, followed by the members; each next
+// points at its neighbour, so iteration works as on lists.
+inline size_t JsonValue::getLength() const {
+    assert(isCompact());
+    return toNode() ? ((const size_t *)toNode())[-1] >> 1 : 0;
+}
+
+inline JsonNode *JsonValue::at(size_t i) const {
+    assert(i < getLength());
+    return (JsonNode *)((char *)toNode() + i * (getTag() == JSON_ARRAY ? JSON_ARRAY_NODE_SIZE : sizeof(JsonNode)));
+}
+
 struct JsonIterator {
     JsonNode *p;
 
@@ -97,7 +174,9 @@ inline JsonIterator end(JsonValue) {
     XX(UNEXPECTED_CHARACTER, "unexpected character") \
     XX(UNQUOTED_KEY, "unquoted key")                 \
     XX(BREAKING_BAD, "breaking bad")                 \
-    XX(ALLOCATION_FAILURE, "allocation failure")
+    XX(ALLOCATION_FAILURE, "allocation failure")     \
+    XX(WRITE_FAILURE, "write failure")               \
+    XX(BAD_UTF8, "bad utf-8")
 
 enum JsonErrno {
 #define XX(no, str) JSON_##no,
@@ -107,29 +186,249 @@ enum JsonErrno {
 
 const char *jsonStrError(int err);
 
+#define JSON_ZONE_SIZE 4096
+
+// Objects wider than this get a hash index from jsonFind.
+#define JSON_INDEX_MIN_WIDTH 8
+
+class JsonAllocator;
+struct JsonIndexMap;
+
+// Returns the first member of object named key, or nullptr. Without an
+// index, the first minWidth members are compared in order; a lookup that
+// gets past them builds an open-addressing index of the whole object in
+// allocator, which every later lookup in that object uses. allocator must
+// be the one the object was parsed into; reset() and deallocate() drop
+// the indexes along with the values. If the index cannot be allocated the
+// rest of the list is scanned instead. Since a lookup may build an index
+// and allocate, jsonFind writes to allocator even though it leaves the
+// tree as it is: threads looking up keys in the same document, read-only
+// as that seems, must hold a lock around each call.
+JsonNode *jsonFind(JsonValue object, const char *key, JsonAllocator &allocator,
+                   size_t minWidth = JSON_INDEX_MIN_WIDTH);
+
+struct JsonAllocatorStats {
+    size_t zones;         // zones holding the current values
+    size_t usedBytes;     // bytes handed out since the last reset
+    size_t reservedBytes; // capacity of those zones, headers included
+    size_t retainedBytes; // capacity of spare zones kept by reset()
+    uint64_t mallocs;     // zones ever obtained from malloc
+    uint64_t frees;       // zones ever returned to free
+};
+
 class JsonAllocator {
     struct Zone {
         Zone *next;
         size_t used;
+        size_t size;
     } *head = nullptr;
+    Zone *spare = nullptr;
+    size_t spareBytes = 0;
+    size_t zoneSize = JSON_ZONE_SIZE;
+    size_t maxZoneSize = JSON_ZONE_SIZE;
+    size_t nextZoneSize = JSON_ZONE_SIZE;
+    size_t retainLimit = (size_t)-1;
+    uint64_t mallocs = 0;
+    uint64_t frees = 0;
+    // Object indexes built by jsonFind, keyed by the first member.
+    JsonIndexMap *indexes = nullptr;
+
+    void *allocateZone(size_t size);
+    void moveFrom(JsonAllocator &x);
 
 public:
     JsonAllocator() = default;
     JsonAllocator(const JsonAllocator &) = delete;
     JsonAllocator &operator=(const JsonAllocator &) = delete;
-    JsonAllocator(JsonAllocator &&x) : head(x.head) {
-        x.head = nullptr;
+    JsonAllocator(JsonAllocator &&x) {
+        moveFrom(x);
     }
     JsonAllocator &operator=(JsonAllocator &&x) {
-        head = x.head;
-        x.head = nullptr;
+        if (this != &x) {
+            deallocate();
+            moveFrom(x);
+        }
         return *this;
     }
     ~JsonAllocator() {
         deallocate();
     }
     void *allocate(size_t size);
+    // Frees every zone, including the ones kept by reset().
     void deallocate();
+    // Invalidates all values like deallocate() but keeps the zones for the
+    // next parse, up to the retain limit, so that parsing documents of
+    // similar size again needs no malloc.
+    void reset();
+    // New zones start at size bytes and double up to maxSize; oversized
+    // requests get a zone of their own. The default is fixed 4 KB zones.
+    void setZoneSize(size_t size, size_t maxSize);
+    // Bytes of spare zones reset() may keep; the rest go back to free.
+    void setRetainLimit(size_t bytes) {
+        retainLimit = bytes;
+    }
+    JsonAllocatorStats stats() const;
+
+    friend JsonNode *jsonFind(JsonValue, const char *, JsonAllocator &, size_t);
+};
+
+// With validateUtf8, the raw bytes of every string and key must be
+// well-formed UTF-8; otherwise the parse fails with JSON_BAD_UTF8 and
+// *endptr at the first byte of the offending sequence. \u escapes of lone
+// surrogates are still decoded as before. Without it, bytes from 0x80 up
+// pass through unchecked.
+//
+// str must be NUL-terminated. The vector scanners load aligned 16- and
+// 32-byte blocks, so they may read up to 15 bytes before str and 31 bytes
+// past the NUL. Those reads never cross a page boundary, so they cannot
+// fault, and the result never depends on them, but memory checkers report
+// them unless the buffer is padded by that much. Compiling gason.cpp with
+// JSON_EXACT_READS defined, which is the default under AddressSanitizer,
+// replaces them with byte loops that stay within the string.
+int jsonParse(char *str, char **endptr, JsonValue *value, JsonAllocator &allocator, bool validateUtf8 = false);
+
+// Parses length bytes at str without modifying them or reading any byte
+// outside them; no NUL terminator or padding is needed, so str may end at
+// the end of a mapping. Strings and keys become JsonStringViews in allocator that point
+// into str, which must outlive the value, except that strings with escapes
+// are decoded into allocator; objects are marked by hasKeyViews(). jsonFind
+// only handles objects parsed in situ. validateUtf8 works as above.
+int jsonParse(const char *str, size_t length, const char **endptr, JsonValue *value, JsonAllocator &allocator,
+              bool validateUtf8 = false);
+
+// One document of a batch.
+struct JsonDocument {
+    JsonValue value;    // the root, if status is JSON_OK
+    int status;         // what jsonParse returned for it
+    size_t index;       // position in the batch, from 0
+    size_t offset;      // offset of its first byte in the buffer
+    size_t errorOffset; // offset of the byte where the error was found
+};
+
+// Receives the documents of a batch in order; returning false ends it.
+typedef bool (*JsonBatchFn)(void *context, const JsonDocument &document);
+
+enum JsonBatchFlags {
+    // Documents are separated by whitespace alone and may span lines.
+    JSON_BATCH_MULTILINE = 1,
+    // The allocator is not reset between documents, so all stay valid.
+    JSON_BATCH_KEEP_VALUES = 2,
+    // Each document is parsed with validateUtf8.
+    JSON_BATCH_VALIDATE_UTF8 = 4
+};
+
+// Parses the documents in length bytes at str in order and passes each to
+// callback. By default the input is NDJSON: no document spans a line
+// break, a line may hold any number of them, and an invalid one only
+// costs the rest of its line. With JSON_BATCH_MULTILINE the first invalid
+// document ends the batch. The allocator is reset before each document,
+// so that its zones are reused and the values of a document live until
+// the next one is parsed. Returns the number of documents passed to
+// callback. The in situ form needs str[length] to be NUL, and ends each
+// line by replacing its newline with NUL; the const form parses views,
+// and reads nothing outside the buffer, as the const jsonParse.
+size_t jsonParseBatch(char *str, size_t length, JsonAllocator &allocator, JsonBatchFn callback, void *context,
+                      int flags = 0);
+size_t jsonParseBatch(const char *str, size_t length, JsonAllocator &allocator, JsonBatchFn callback, void *context,
+                      int flags = 0);
+
+#define JSON_STACK_SIZE 32
+
+// Parses a document that arrives in chunks into the same tree as
+// jsonParse. Strings and keys are copied into allocator, so a chunk need
+// not outlive the feed() call that passes it; a token cut off by the end
+// of a chunk is kept in a buffer of the parser until it is complete.
+class JsonPushParser {
+    enum PendingKind { PENDING_NONE, PENDING_STRING, PENDING_SCALAR };
+
+    JsonAllocator &allocator;
+    JsonNode *tails[JSON_STACK_SIZE];
+    JsonTag tags[JSON_STACK_SIZE];
+    char *keys[JSON_STACK_SIZE];
+    int pos = -1;
+    bool separator = true;
+    bool done = false;
+    // The last byte consumed closed a string, so the next must delimit it.
+    bool stringEnded = false;
+    JsonValue root;
+    int status = JSON_OK;
+    size_t chunkOffset = 0;
+    size_t errorOffset = 0;
+    PendingKind pendingKind = PENDING_NONE;
+    // The raw bytes of the cut-off token, after the quote for strings.
+    char *pending = nullptr;
+    size_t pendingSize = 0;
+    size_t pendingCapacity = 0;
+    size_t pendingOffset = 0;
+    // The pending string ends in a backslash whose escape is still to come.
+    bool pendingEscape = false;
+
+    int fail(int error, size_t offset);
+    bool appendPending(const char *data, size_t size);
+    int string(const char *body, const char *quote, size_t offset);
+    const char *scalar(const char *token, const char *end, size_t offset);
+    int push(JsonValue o, size_t offset);
+    void resume(const char *&s, const char *end);
+
+public:
+    explicit JsonPushParser(JsonAllocator &allocator)
+        : allocator(allocator) {
+    }
+    JsonPushParser(const JsonPushParser &) = delete;
+    JsonPushParser &operator=(const JsonPushParser &) = delete;
+    ~JsonPushParser();
+    // Consumes the next size bytes of the document. Returns JSON_OK while
+    // they can still be part of a valid one, and otherwise the error
+    // jsonParse would report, which every later call repeats. Bytes after
+    // the value other than whitespace are unexpected characters.
+    int feed(const char *data, size_t size);
+    // Ends the input. Returns JSON_OK and sets *value if it held a
+    // complete value; JSON_BREAKING_BAD if it was cut short.
+    int finish(JsonValue *value);
+    // Offset in the stream of the byte where the error was found.
+    size_t getErrorOffset() const {
+        return errorOffset;
+    }
+    // Starts over for a new document; values already parsed stay in the
+    // allocator.
+    void reset();
 };
 
-int jsonParse(char *str, char **endptr, JsonValue *value, JsonAllocator &allocator);
+// Copies the containers of a parsed value into one block of allocator,
+// each as a compact run, in breadth-first order, and points value at the
+// copy. Strings and boxed integers are shared with the original, whose
+// nodes stay in the allocator until it is reset. Returns JSON_OK or
+// JSON_ALLOCATION_FAILURE, which leaves value untouched.
+int jsonCompact(JsonValue *value, JsonAllocator &allocator);
+
+// A growable output buffer for jsonWrite, which appends to it.
+struct JsonBuffer {
+    char *data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    JsonBuffer() = default;
+    JsonBuffer(const JsonBuffer &) = delete;
+    JsonBuffer &operator=(const JsonBuffer &) = delete;
+    ~JsonBuffer();
+    void clear() {
+        size = 0;
+    }
+};
+
+// Receives consecutive pieces of the output; returning false stops the
+// writer with JSON_WRITE_FAILURE.
+typedef bool (*JsonWriteFn)(void *context, const char *data, size_t size);
+
+// Serializes value compactly, or indented by indent spaces per level.
+// Doubles are printed with Grisu2: the digits always read back to the
+// same bits, but are not always the shortest that do, since about 0.06%
+// of doubles get one digit more than needed. They always have a fraction
+// or exponent so that they parse as doubles again; infinities are written
+// as null. Strings escape quotes,
+// backslashes, control characters and DEL, and copy all other bytes.
+// Object keys are read from key or keyView as hasKeyViews() says. Returns
+// JSON_OK, JSON_ALLOCATION_FAILURE or JSON_WRITE_FAILURE.
+int jsonWrite(JsonValue value, JsonBuffer &buffer, int indent = 0);
+// The same through a 4 KB buffer that is passed to write whenever it fills.
+int jsonWrite(JsonValue value, JsonWriteFn write, void *context, int indent = 0);
@@ -10,6 +10,6 @@
 
 @interface Json11 : NSObject
 
-- (NSString*)parse:(NSString*)json;
+- (id)parse:(NSString*)json;
 
 @end
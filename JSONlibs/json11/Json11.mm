@@ -8,25 +8,21 @@
 
 #import "Json11.h"
 #import "json11.hpp"
-#import "CppStringAdditions.h"
 
 @implementation Json11
 
-- (NSString*)parse:(NSString*)json {
+- (id)parse:(NSString*)json {
     
     const char* data = [json UTF8String];
     
-    json11::Json parser;
+    std::string err;
+    json11::Json parsed = json11::Json::parse(data, err);
+    if (!err.empty()) {
+        fprintf(stderr, "%s\n", err.c_str());
+        return nil;
+    }
     
-    parser = json11::Json(data);
-    
-    std::string jsonString;
-    
-    parser.dump(jsonString);
-
-    //printf("%s", jsonString.c_str());
-    
-    return [NSString stringWithstring:jsonString];
+    return [NSNumber numberWithBool:YES];
 
 }
 
@@ -10,6 +10,6 @@
 
 @interface JsonModernCPlusPlus : NSObject
 
-- (NSString*)parse:(NSString*)json;
+- (id)parse:(NSString*)json;
 
 @end
@@ -8,23 +8,23 @@
 
 #import "JsonModernCPlusPlus.h"
 #import "json.hpp"
-#import "CppStringAdditions.h"
 
 using json = nlohmann::json;
 
 @implementation JsonModernCPlusPlus
 
-- (NSString*)parse:(NSString*)json {
+- (id)parse:(NSString*)json {
     
     const char* data = [json UTF8String];
     
-    auto j3 = json::parse(data);
-
-    std::string jsonString = j3.dump();
-    
-    //printf("%s", jsonString.c_str());
+    try {
+        auto j3 = json::parse(data);
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return nil;
+    }
     
-    return [NSString stringWithstring:jsonString];
+    return [NSNumber numberWithBool:YES];
 
 }
 
@@ -0,0 +1,543 @@
+#include "adapters.h"
+
+#include "gason/gason.h"
+#include "json11/json11.hpp"
+#include "jsonmoderncplusplus/json.hpp"
+#include "rapidjson/document.h"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+class GasonAdapter : public Adapter {
+protected:
+    // Lookups may add object indexes to the allocator.
+    mutable JsonAllocator allocator;
+    JsonValue root;
+    bool parsed = false;
+    // Keys are JsonStringViews, as parsed from a const buffer.
+    bool views = false;
+
+private:
+    bool reuse = false;
+    bool indexed = false;
+    JsonBuffer out;
+
+    size_t keyLength(const JsonNode *node) const {
+        return views ? node->keyView->length : strlen(node->key);
+    }
+    bool keyEquals(const JsonNode *node, const char *key) const {
+        if (!views)
+            return !strcmp(node->key, key);
+        size_t length = strlen(key);
+        return node->keyView->length == length && !memcmp(node->keyView->data, key, length);
+    }
+
+    uint64_t walk(JsonValue v) const {
+        uint64_t sum = 1;
+        switch (v.getTag()) {
+        case JSON_ARRAY:
+            for (auto i : v)
+                sum += walk(i->value);
+            break;
+        case JSON_OBJECT:
+            for (auto i : v)
+                sum += keyLength(i) + walk(i->value);
+            break;
+        case JSON_STRING:
+            sum += v.toStringView().length;
+            break;
+        default:
+            break;
+        }
+        return sum;
+    }
+
+    bool resolve(const PathStep *path, size_t length, JsonValue &v) const {
+        v = root;
+        for (size_t i = 0; i < length; ++i) {
+            JsonNode *node = nullptr;
+            if (path[i].key && v.getTag() == JSON_OBJECT && indexed) {
+                node = jsonFind(v, path[i].key, allocator);
+            } else if (path[i].key && v.getTag() == JSON_OBJECT) {
+                node = v.toNode();
+                while (node && !keyEquals(node, path[i].key))
+                    node = node->next;
+            } else if (!path[i].key && v.getTag() == JSON_ARRAY && v.isCompact()) {
+                node = path[i].index < v.getLength() ? v.at(path[i].index) : nullptr;
+            } else if (!path[i].key && v.getTag() == JSON_ARRAY) {
+                node = v.toNode();
+                for (size_t n = path[i].index; node && n; --n)
+                    node = node->next;
+            }
+            if (!node)
+                return false;
+            v = node->value;
+        }
+        return true;
+    }
+
+public:
+    const char *name() const override {
+        return "gason";
+    }
+    bool parse(char *json, size_t) override {
+        char *endptr;
+        parsed = true;
+        return jsonParse(json, &endptr, &root, allocator) == JSON_OK;
+    }
+    uint64_t walk() const override {
+        return walk(root);
+    }
+    size_t dump(bool pretty) override {
+        out.clear();
+        if (jsonWrite(root, out, pretty ? 4 : 0) != JSON_OK)
+            return 0;
+        return out.size;
+    }
+    uint64_t find(const PathStep *path, size_t length) const override {
+        JsonValue v;
+        if (!resolve(path, length, v))
+            return 0;
+        return 1 + (v.getTag() == JSON_STRING ? v.toStringView().length : 0);
+    }
+    uint64_t iterate(const PathStep *path, size_t length) const override {
+        JsonValue v;
+        if (!resolve(path, length, v))
+            return 0;
+        uint64_t sum = 0;
+        if (v.getTag() == JSON_OBJECT) {
+            for (auto i : v)
+                sum += 1 + keyLength(i);
+        } else if (v.getTag() == JSON_ARRAY) {
+            for (JsonNode *node = v.toNode(); node; node = node->next)
+                ++sum;
+        }
+        return sum;
+    }
+    bool keepsInput() const override {
+        return true;
+    }
+    void clear() override {
+        if (reuse)
+            allocator.reset();
+        else
+            allocator.deallocate();
+        root = JsonValue();
+        parsed = false;
+    }
+    // Reuse keeps the zones of earlier parses, which grow geometrically so
+    // that large documents need few of them.
+    bool setReuse(bool enable) override {
+        reuse = enable;
+        if (reuse)
+            allocator.setZoneSize(JSON_ZONE_SIZE, 1 << 20);
+        else
+            allocator.setZoneSize(JSON_ZONE_SIZE, JSON_ZONE_SIZE);
+        return true;
+    }
+    // jsonFind compares NUL-terminated keys.
+    bool setLookupIndex(bool enable) override {
+        indexed = enable && !views;
+        return indexed == enable;
+    }
+    bool arenaUsage(size_t &used, size_t &reserved) const override {
+        if (!parsed)
+            return false;
+        JsonAllocatorStats stats = allocator.stats();
+        used = stats.usedBytes;
+        reserved = stats.reservedBytes + stats.retainedBytes;
+        return true;
+    }
+};
+
+// gason with every DOM rebuilt by jsonCompact, so that containers are
+// contiguous and arrays can be indexed directly.
+class GasonFlatAdapter : public GasonAdapter {
+public:
+    const char *name() const override {
+        return "gason-flat";
+    }
+    bool parse(char *json, size_t size) override {
+        return GasonAdapter::parse(json, size) && jsonCompact(&root, allocator) == JSON_OK;
+    }
+};
+
+// gason checking that every string is well-formed UTF-8 as it parses.
+class GasonUtf8Adapter : public GasonAdapter {
+public:
+    const char *name() const override {
+        return "gason-utf8";
+    }
+    bool parse(char *json, size_t) override {
+        char *endptr;
+        parsed = true;
+        return jsonParse(json, &endptr, &root, allocator, true) == JSON_OK;
+    }
+};
+
+// gason parsing the input as a const buffer, with strings left in place
+// as views instead of being unescaped in situ.
+class GasonViewAdapter : public GasonAdapter {
+public:
+    GasonViewAdapter() {
+        views = true;
+    }
+    const char *name() const override {
+        return "gason-view";
+    }
+    bool parse(char *json, size_t size) override {
+        const char *endptr;
+        parsed = true;
+        return jsonParse((const char *)json, size, &endptr, &root, allocator) == JSON_OK;
+    }
+};
+
+// gason fed through JsonPushParser in fixed-size chunks, as a socket
+// reader would; strings are copied out of each chunk into the arena.
+class GasonPushAdapter : public GasonAdapter {
+    static const size_t kChunkSize = 64 << 10;
+
+public:
+    const char *name() const override {
+        return "gason-push";
+    }
+    bool parse(char *json, size_t size) override {
+        JsonPushParser parser(allocator);
+        parsed = true;
+        for (size_t offset = 0; offset < size; offset += kChunkSize)
+            if (parser.feed(json + offset, std::min(kChunkSize, size - offset)) != JSON_OK)
+                return false;
+        return parser.finish(&root) == JSON_OK;
+    }
+    bool keepsInput() const override {
+        return false;
+    }
+};
+
+class RapidjsonAdapter : public Adapter {
+    typedef rapidjson::MemoryPoolAllocator<> Pool;
+    typedef rapidjson::GenericDocument<rapidjson::UTF8<>, Pool, Pool> PooledDocument;
+
+    std::unique_ptr<rapidjson::Document> doc;
+    const rapidjson::Value *root = nullptr;
+    rapidjson::StringBuffer out;
+    rapidjson::Writer<rapidjson::StringBuffer> writer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> prettyWriter;
+
+    // Reuse mode keeps the DOM and the parse stack in pools over our own
+    // buffers, which are grown after any parse that spilled into chunks.
+    bool reuse = false;
+    std::vector<char> valueBuffer;
+    std::vector<char> stackBuffer;
+    std::unique_ptr<Pool> valuePool;
+    std::unique_ptr<Pool> stackPool;
+    std::unique_ptr<PooledDocument> pooled;
+
+    void resetPools(size_t valueSize, size_t stackSize) {
+        pooled.reset();
+        valuePool.reset();
+        stackPool.reset();
+        valueBuffer.resize(valueSize);
+        stackBuffer.resize(stackSize);
+        valuePool.reset(new Pool(valueBuffer.data(), valueBuffer.size()));
+        stackPool.reset(new Pool(stackBuffer.data(), stackBuffer.size()));
+        pooled.reset(new PooledDocument(valuePool.get(), 1024, stackPool.get()));
+    }
+
+    static uint64_t walk(const rapidjson::Value &v) {
+        uint64_t sum = 1;
+        if (v.IsArray()) {
+            for (rapidjson::Value::ConstValueIterator i = v.Begin(); i != v.End(); ++i)
+                sum += walk(*i);
+        } else if (v.IsObject()) {
+            for (rapidjson::Value::ConstMemberIterator i = v.MemberBegin(); i != v.MemberEnd(); ++i)
+                sum += i->name.GetStringLength() + walk(i->value);
+        } else if (v.IsString()) {
+            sum += v.GetStringLength();
+        }
+        return sum;
+    }
+
+    const rapidjson::Value *resolve(const PathStep *path, size_t length) const {
+        const rapidjson::Value *v = root;
+        for (size_t i = 0; i < length; ++i) {
+            if (path[i].key && v->IsObject()) {
+                rapidjson::Value::ConstMemberIterator it = v->FindMember(path[i].key);
+                if (it == v->MemberEnd())
+                    return nullptr;
+                v = &it->value;
+            } else if (!path[i].key && v->IsArray() && path[i].index < v->Size()) {
+                v = &(*v)[(rapidjson::SizeType)path[i].index];
+            } else {
+                return nullptr;
+            }
+        }
+        return v;
+    }
+
+public:
+    RapidjsonAdapter() : prettyWriter(out) {}
+
+    const char *name() const override {
+        return "rapidjson";
+    }
+    bool parse(char *json, size_t) override {
+        if (reuse) {
+            pooled->Parse(json);
+            root = pooled.get();
+            return !pooled->HasParseError();
+        }
+        doc.reset(new rapidjson::Document);
+        doc->Parse(json);
+        root = doc.get();
+        return !doc->HasParseError();
+    }
+    uint64_t walk() const override {
+        return walk(*root);
+    }
+    size_t dump(bool pretty) override {
+        out.Clear();
+        if (pretty) {
+            prettyWriter.Reset(out);
+            root->Accept(prettyWriter);
+        } else {
+            writer.Reset(out);
+            root->Accept(writer);
+        }
+        return out.GetSize();
+    }
+    uint64_t find(const PathStep *path, size_t length) const override {
+        const rapidjson::Value *v = resolve(path, length);
+        if (!v)
+            return 0;
+        return 1 + (v->IsString() ? v->GetStringLength() : 0);
+    }
+    uint64_t iterate(const PathStep *path, size_t length) const override {
+        const rapidjson::Value *v = resolve(path, length);
+        uint64_t sum = 0;
+        if (v && v->IsObject()) {
+            for (rapidjson::Value::ConstMemberIterator i = v->MemberBegin(); i != v->MemberEnd(); ++i)
+                sum += 1 + i->name.GetStringLength();
+        } else if (v && v->IsArray()) {
+            sum = v->Size();
+        }
+        return sum;
+    }
+    void clear() override {
+        root = nullptr;
+        doc.reset();
+        if (!reuse)
+            return;
+        pooled->SetNull();
+        size_t valueUsed = valuePool->Capacity();
+        size_t stackUsed = stackPool->Capacity();
+        if (valueUsed > valueBuffer.size() || stackUsed > stackBuffer.size()) {
+            resetPools(std::max(valueUsed * 2, valueBuffer.size()), std::max(stackUsed * 2, stackBuffer.size()));
+        } else {
+            valuePool->Clear();
+            stackPool->Clear();
+        }
+    }
+    bool setReuse(bool enable) override {
+        reuse = enable;
+        if (reuse)
+            resetPools(64 * 1024, 16 * 1024);
+        return true;
+    }
+    bool arenaUsage(size_t &used, size_t &reserved) const override {
+        if (!root)
+            return false;
+        const Pool &pool = reuse ? *valuePool : doc->GetAllocator();
+        used = pool.Size();
+        reserved = pool.Capacity();
+        return true;
+    }
+};
+
+class Json11Adapter : public Adapter {
+    json11::Json root;
+    std::string out;
+
+    static uint64_t walk(const json11::Json &v) {
+        uint64_t sum = 1;
+        switch (v.type()) {
+        case json11::Json::ARRAY:
+            for (const json11::Json &i : v.array_items())
+                sum += walk(i);
+            break;
+        case json11::Json::OBJECT:
+            for (const auto &i : v.object_items())
+                sum += i.first.size() + walk(i.second);
+            break;
+        case json11::Json::STRING:
+            sum += v.string_value().size();
+            break;
+        default:
+            break;
+        }
+        return sum;
+    }
+
+    const json11::Json *resolve(const PathStep *path, size_t length) const {
+        const json11::Json *v = &root;
+        for (size_t i = 0; i < length; ++i) {
+            if (path[i].key && v->is_object()) {
+                const json11::Json::object &items = v->object_items();
+                json11::Json::object::const_iterator it = items.find(path[i].key);
+                if (it == items.end())
+                    return nullptr;
+                v = &it->second;
+            } else if (!path[i].key && v->is_array() && path[i].index < v->array_items().size()) {
+                v = &v->array_items()[path[i].index];
+            } else {
+                return nullptr;
+            }
+        }
+        return v;
+    }
+
+public:
+    const char *name() const override {
+        return "json11";
+    }
+    bool parse(char *json, size_t size) override {
+        std::string err;
+        root = json11::Json::parse(std::string(json, size), err);
+        return err.empty();
+    }
+    uint64_t walk() const override {
+        return walk(root);
+    }
+    size_t dump(bool pretty) override {
+        // json11 has no pretty printer.
+        if (pretty)
+            return 0;
+        out.clear();
+        root.dump(out);
+        return out.size();
+    }
+    uint64_t find(const PathStep *path, size_t length) const override {
+        const json11::Json *v = resolve(path, length);
+        if (!v)
+            return 0;
+        return 1 + (v->is_string() ? v->string_value().size() : 0);
+    }
+    uint64_t iterate(const PathStep *path, size_t length) const override {
+        const json11::Json *v = resolve(path, length);
+        uint64_t sum = 0;
+        if (v && v->is_object()) {
+            for (const auto &i : v->object_items())
+                sum += 1 + i.first.size();
+        } else if (v && v->is_array()) {
+            sum = v->array_items().size();
+        }
+        return sum;
+    }
+    void clear() override {
+        root = json11::Json();
+    }
+};
+
+class NlohmannAdapter : public Adapter {
+    nlohmann::json root;
+    std::string out;
+
+    static uint64_t walk(const nlohmann::json &v) {
+        uint64_t sum = 1;
+        if (v.is_array()) {
+            for (const nlohmann::json &i : v)
+                sum += walk(i);
+        } else if (v.is_object()) {
+            for (nlohmann::json::const_iterator i = v.begin(); i != v.end(); ++i)
+                sum += i.key().size() + walk(i.value());
+        } else if (v.is_string()) {
+            sum += v.get_ptr<const nlohmann::json::string_t *const>()->size();
+        }
+        return sum;
+    }
+
+    const nlohmann::json *resolve(const PathStep *path, size_t length) const {
+        const nlohmann::json *v = &root;
+        for (size_t i = 0; i < length; ++i) {
+            if (path[i].key && v->is_object()) {
+                nlohmann::json::const_iterator it = v->find(path[i].key);
+                if (it == v->end())
+                    return nullptr;
+                v = &it.value();
+            } else if (!path[i].key && v->is_array() && path[i].index < v->size()) {
+                v = &(*v)[path[i].index];
+            } else {
+                return nullptr;
+            }
+        }
+        return v;
+    }
+
+public:
+    const char *name() const override {
+        return "nlohmann";
+    }
+    bool parse(char *json, size_t size) override {
+        try {
+            root = nlohmann::json::parse(std::string(json, size));
+        } catch (const std::exception &) {
+            return false;
+        }
+        return true;
+    }
+    uint64_t walk() const override {
+        return walk(root);
+    }
+    size_t dump(bool pretty) override {
+        out = root.dump(pretty ? 4 : -1);
+        return out.size();
+    }
+    uint64_t find(const PathStep *path, size_t length) const override {
+        const nlohmann::json *v = resolve(path, length);
+        if (!v)
+            return 0;
+        return 1 + (v->is_string() ? v->get_ptr<const nlohmann::json::string_t *const>()->size() : 0);
+    }
+    uint64_t iterate(const PathStep *path, size_t length) const override {
+        const nlohmann::json *v = resolve(path, length);
+        uint64_t sum = 0;
+        if (v && v->is_object()) {
+            for (nlohmann::json::const_iterator i = v->begin(); i != v->end(); ++i)
+                sum += 1 + i.key().size();
+        } else if (v && v->is_array()) {
+            sum = v->size();
+        }
+        return sum;
+    }
+    void clear() override {
+        root = nullptr;
+    }
+};
+
+template <typename T>
+std::unique_ptr<Adapter> create() {
+    return std::unique_ptr<Adapter>(new T);
+}
+
+} // namespace
+
+const std::vector<AdapterInfo> &adapterRegistry() {
+    static const std::vector<AdapterInfo> registry = {
+        {"gason", create<GasonAdapter>},
+        {"gason-flat", create<GasonFlatAdapter>},
+        {"gason-utf8", create<GasonUtf8Adapter>},
+        {"gason-view", create<GasonViewAdapter>},
+        {"gason-push", create<GasonPushAdapter>},
+        {"rapidjson", create<RapidjsonAdapter>},
+        {"json11", create<Json11Adapter>},
+        {"nlohmann", create<NlohmannAdapter>},
+    };
+    return registry;
+}
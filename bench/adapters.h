@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// One step of a lookup path: an object key, or an array index when key is
+// null.
+struct PathStep {
+    const char *key;
+    size_t index;
+};
+
+// One parser under test. An adapter owns the DOM produced by parse() until
+// clear() is called, so construction, traversal, serialization and teardown
+// can be timed apart.
+class Adapter {
+public:
+    virtual ~Adapter() {}
+    virtual const char *name() const = 0;
+    // json is a writable, NUL-terminated copy of size bytes that stays
+    // alive until clear(); in-situ parsers may modify it.
+    virtual bool parse(char *json, size_t size) = 0;
+    // Visits every value and key of the DOM. The checksum counts values plus
+    // the bytes of every decoded string and key, so it must agree across
+    // libraries for the same document.
+    virtual uint64_t walk() const = 0;
+    // Serializes the DOM into an adapter-owned buffer, compactly or indented
+    // by four spaces, and returns its size in bytes, or 0 when the library
+    // has no such writer.
+    virtual size_t dump(bool pretty) = 0;
+    // Follows path from the root the way a handler would, with the
+    // library's own lookup. Returns 0 if a step is missing, otherwise 1 plus
+    // the length of the string found (0 for other values).
+    virtual uint64_t find(const PathStep *path, size_t length) const = 0;
+    // Visits the members or elements of the container at path and returns
+    // their count plus the bytes of their keys, or 0 if it is missing.
+    virtual uint64_t iterate(const PathStep *path, size_t length) const = 0;
+    virtual void clear() = 0;
+    // Asks the adapter to keep its allocator and buffers across parses, so
+    // that after warmup a parse/clear cycle needs no heap allocation.
+    // Returns false if the library cannot work that way.
+    virtual bool setReuse(bool enable) {
+        return !enable;
+    }
+    // Asks the adapter to look keys up through a hash index that the
+    // library builds on demand for wide objects. Returns false if the
+    // library has no such index.
+    virtual bool setLookupIndex(bool enable) {
+        return !enable;
+    }
+    // True if the DOM points into the buffer passed to parse(), which then
+    // has to live as long as the DOM.
+    virtual bool keepsInput() const {
+        return false;
+    }
+    // For DOMs built in an arena: sets the bytes handed out to the current
+    // DOM and the bytes the arena holds from the heap. False for other
+    // allocators.
+    virtual bool arenaUsage(size_t & /*used*/, size_t & /*reserved*/) const {
+        return false;
+    }
+};
+
+struct AdapterInfo {
+    const char *name;
+    std::unique_ptr<Adapter> (*create)();
+};
+
+const std::vector<AdapterInfo> &adapterRegistry();
@@ -0,0 +1,141 @@
+#include "alloc_tracker.h"
+
+#include <errno.h>
+#include <stddef.h>
+
+// Interposes the C allocator by defining malloc and friends in the
+// executable and forwarding to glibc's __libc_* entry points. operator new
+// and the containers of json11 and nlohmann end up here too, since
+// libstdc++ allocates through malloc. Counters are thread-local so
+// concurrent benchmarks each see their own traffic.
+
+AllocStats &AllocStats::operator+=(const AllocStats &x) {
+    allocs += x.allocs;
+    frees += x.frees;
+    bytes += x.bytes;
+    freedBytes += x.freedBytes;
+    live += x.live;
+    if (x.peak > peak)
+        peak = x.peak;
+    return *this;
+}
+
+#ifdef __GLIBC__
+
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *p);
+}
+
+static __thread bool tracking;
+static __thread AllocStats stats;
+
+static inline void onAlloc(void *p, size_t size) {
+    if (!tracking || !p)
+        return;
+    ++stats.allocs;
+    stats.bytes += size;
+    stats.live += malloc_usable_size(p);
+    if (stats.live > stats.peak)
+        stats.peak = stats.live;
+}
+
+static inline void onFreed(size_t usable) {
+    ++stats.frees;
+    stats.freedBytes += usable;
+    stats.live -= usable;
+}
+
+static inline void onFree(void *p) {
+    if (!tracking || !p)
+        return;
+    onFreed(malloc_usable_size(p));
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    onAlloc(p, size);
+    return p;
+}
+
+void *calloc(size_t n, size_t size) {
+    void *p = __libc_calloc(n, size);
+    onAlloc(p, n * size);
+    return p;
+}
+
+void *realloc(void *old, size_t size) {
+    // Counted as a free of the old block plus a new allocation, whether or
+    // not glibc managed to resize in place. On failure the old block stays
+    // live; a zero size frees it and returns NULL.
+    bool counted = tracking && old;
+    size_t usable = counted ? malloc_usable_size(old) : 0;
+    void *p = __libc_realloc(old, size);
+    if (counted && (p || !size))
+        onFreed(usable);
+    onAlloc(p, size);
+    return p;
+}
+
+void *memalign(size_t alignment, size_t size) {
+    void *p = __libc_memalign(alignment, size);
+    onAlloc(p, size);
+    return p;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    if (alignment % sizeof(void *) || (alignment & (alignment - 1)))
+        return EINVAL;
+    void *p = memalign(alignment, size);
+    if (!p && size)
+        return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void free(void *p) {
+    onFree(p);
+    __libc_free(p);
+}
+
+} // extern "C"
+
+bool allocTrackingAvailable() {
+    return true;
+}
+
+void allocTrackingStart() {
+    stats = AllocStats();
+    tracking = true;
+}
+
+AllocStats allocTrackingStop() {
+    tracking = false;
+    return stats;
+}
+
+#else
+
+bool allocTrackingAvailable() {
+    return false;
+}
+
+void allocTrackingStart() {
+}
+
+AllocStats allocTrackingStop() {
+    return AllocStats();
+}
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// Heap traffic of one thread between allocTrackingStart() and
+// allocTrackingStop(). live and peak are in usable bytes as reported by the
+// C library, so they include per-block rounding; bytes is what was asked for.
+struct AllocStats {
+    uint64_t allocs = 0; // blocks returned by malloc, calloc, realloc, memalign
+    uint64_t frees = 0;
+    uint64_t bytes = 0;
+    uint64_t freedBytes = 0; // usable size of the blocks freed
+    int64_t live = 0;
+    int64_t peak = 0;
+
+    AllocStats &operator+=(const AllocStats &x);
+};
+
+// False where the C library allocator cannot be interposed (non-glibc).
+bool allocTrackingAvailable();
+void allocTrackingStart();
+AllocStats allocTrackingStop();
@@ -0,0 +1,122 @@
+#include "baseline.h"
+#include "corpus.h"
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <stdio.h>
+
+static const int kFormatVersion = 1;
+
+static void writeSamples(rapidjson::Writer<rapidjson::StringBuffer> &writer, const char *key,
+                         const std::vector<uint64_t> &samples) {
+    writer.Key(key);
+    writer.StartArray();
+    for (uint64_t ns : samples)
+        writer.Uint64(ns);
+    writer.EndArray();
+}
+
+bool saveResults(const std::string &path, const std::vector<RunResult> &results, std::string &error) {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        error = "cannot create " + path;
+        return false;
+    }
+    fprintf(fp, "{\"version\":%d,\"results\":[\n", kFormatVersion);
+    bool first = true;
+    for (const RunResult &r : results) {
+        if (!r.ok)
+            continue;
+        rapidjson::StringBuffer line;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(line);
+        writer.StartObject();
+        writer.Key("library");
+        writer.String(r.library.c_str());
+        writer.Key("corpus");
+        writer.String(r.corpus.c_str());
+        writer.Key("workload");
+        writer.String(workloadName(r.workload));
+        writer.Key("cache");
+        writer.String(cacheModeName(r.cache));
+        writer.Key("bytes");
+        writer.Uint64(r.bytes);
+        writeSamples(writer, "parse_ns", r.parseNs);
+        writeSamples(writer, "phase_ns", r.phaseNs);
+        writer.EndObject();
+        fprintf(fp, "%s%s", first ? "" : ",\n", line.GetString());
+        first = false;
+    }
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp) != 0) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+static bool readSamples(const rapidjson::Value &v, const char *key, std::vector<uint64_t> &samples) {
+    rapidjson::Value::ConstMemberIterator it = v.FindMember(key);
+    if (it == v.MemberEnd() || !it->value.IsArray())
+        return false;
+    for (rapidjson::Value::ConstValueIterator i = it->value.Begin(); i != it->value.End(); ++i) {
+        if (!i->IsUint64())
+            return false;
+        samples.push_back(i->GetUint64());
+    }
+    return true;
+}
+
+static bool readString(const rapidjson::Value &v, const char *key, std::string &out) {
+    rapidjson::Value::ConstMemberIterator it = v.FindMember(key);
+    if (it == v.MemberEnd() || !it->value.IsString())
+        return false;
+    out.assign(it->value.GetString(), it->value.GetStringLength());
+    return true;
+}
+
+bool loadResults(const std::string &path, std::vector<RunResult> &results, std::string &error) {
+    Corpus file;
+    if (!loadCorpus(path, file)) {
+        error = "cannot read " + path;
+        return false;
+    }
+    rapidjson::Document doc;
+    doc.Parse(file.data.c_str());
+    if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("version") || !doc["version"].IsInt() ||
+        doc["version"].GetInt() != kFormatVersion || !doc.HasMember("results") || !doc["results"].IsArray()) {
+        error = path + " is not a benchmark result file";
+        return false;
+    }
+
+    const rapidjson::Value &list = doc["results"];
+    for (rapidjson::Value::ConstValueIterator i = list.Begin(); i != list.End(); ++i) {
+        RunResult r;
+        std::string workload;
+        if (!i->IsObject() || !readString(*i, "library", r.library) || !readString(*i, "corpus", r.corpus) ||
+            !readString(*i, "workload", workload) || !workloadFromName(workload.c_str(), r.workload) ||
+            !i->HasMember("bytes") || !(*i)["bytes"].IsUint64() ||
+            !readSamples(*i, "parse_ns", r.parseNs) || !readSamples(*i, "phase_ns", r.phaseNs)) {
+            error = path + ": malformed result";
+            return false;
+        }
+        std::string cache;
+        if (readString(*i, "cache", cache) && !cacheModeFromName(cache.c_str(), r.cache)) {
+            error = path + ": unknown cache mode " + cache;
+            return false;
+        }
+        r.bytes = (size_t)(*i)["bytes"].GetUint64();
+        r.ok = true;
+        results.push_back(r);
+    }
+    return true;
+}
+
+const RunResult *findResult(const std::vector<RunResult> &results, const RunResult &key) {
+    for (const RunResult &r : results)
+        if (r.library == key.library && r.corpus == key.corpus && r.workload == key.workload &&
+            r.cache == key.cache)
+            return &r;
+    return nullptr;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "runner.h"
+
+#include <string>
+#include <vector>
+
+// Raw per-iteration samples of a run, stored as JSON with one result per
+// line so that later runs can be compared against them.
+bool saveResults(const std::string &path, const std::vector<RunResult> &results, std::string &error);
+bool loadResults(const std::string &path, std::vector<RunResult> &results, std::string &error);
+
+// The result for the same library, corpus and workload, if any.
+const RunResult *findResult(const std::vector<RunResult> &results, const RunResult &key);
@@ -0,0 +1,38 @@
+#include "corpus.h"
+#include <stdio.h>
+
+static const char *const kDefaultCorpora[] = {
+    "track.chart.get.json",
+    "twitter_timeline.json",
+    "repeat.json",
+    "location.get.json",
+};
+
+bool loadCorpus(const std::string &path, Corpus &corpus) {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    std::string data;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.append(buf, n);
+    bool ok = !ferror(fp);
+    fclose(fp);
+    if (!ok)
+        return false;
+
+    size_t slash = path.find_last_of('/');
+    corpus.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    corpus.path = path;
+    corpus.data.swap(data);
+    return true;
+}
+
+std::vector<std::string> defaultCorpusPaths(const std::string &dir) {
+    std::vector<std::string> paths;
+    for (const char *name : kDefaultCorpora)
+        paths.push_back(dir + "/" + name);
+    return paths;
+}
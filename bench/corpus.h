@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct Corpus {
+    std::string name;
+    std::string path;
+    std::string data;
+};
+
+// Reads a whole file; name is the path's basename.
+bool loadCorpus(const std::string &path, Corpus &corpus);
+
+// The documents bundled with the iOS app, resolved against dir.
+std::vector<std::string> defaultCorpusPaths(const std::string &dir);
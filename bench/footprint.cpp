@@ -0,0 +1,54 @@
+#include "footprint.h"
+#include "alloc_tracker.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// glibc prefixes every chunk with its size field; usable size already
+// accounts for alignment padding.
+static const int64_t kChunkHeader = sizeof(size_t);
+
+double Footprint::overhead() const {
+    return heapBytes > 0 ? double(heapBytes - requestedBytes) / heapBytes : 0;
+}
+
+double Footprint::perJsonByte() const {
+    if (!bytes)
+        return 0;
+    return double(heapBytes + (keepsInput ? bytes + 1 : 0)) / bytes;
+}
+
+Footprint measureFootprint(Adapter &adapter, const Corpus &corpus) {
+    Footprint result;
+    result.library = adapter.name();
+    result.corpus = corpus.name;
+    result.bytes = corpus.data.size();
+    result.keepsInput = adapter.keepsInput();
+
+    std::vector<char> buffer(corpus.data.size() + 1);
+    memcpy(buffer.data(), corpus.data.c_str(), buffer.size());
+    bool ok = adapter.parse(buffer.data(), corpus.data.size());
+    adapter.clear();
+    if (!ok)
+        return result;
+
+    memcpy(buffer.data(), corpus.data.c_str(), buffer.size());
+    allocTrackingStart();
+    ok = adapter.parse(buffer.data(), corpus.data.size());
+    AllocStats stats = allocTrackingStop();
+    result.hasArena = ok && adapter.arenaUsage(result.arenaUsed, result.arenaReserved);
+    adapter.clear();
+    if (!ok)
+        return result;
+
+    // The tracker knows requested sizes only at allocation time, so the
+    // live request is estimated by treating freed blocks as fully used.
+    // That is exact for parsers that free nothing while parsing.
+    result.blocks = (int64_t)(stats.allocs - stats.frees);
+    result.requestedBytes = std::max<int64_t>(0, (int64_t)(stats.bytes - stats.freedBytes));
+    result.heapBytes = stats.live + result.blocks * kChunkHeader;
+    result.transientBytes = stats.freedBytes;
+    result.ok = true;
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "adapters.h"
+#include "corpus.h"
+
+#include <stdint.h>
+#include <string>
+
+// What a parsed document costs in memory while it is alive.
+struct Footprint {
+    std::string library;
+    std::string corpus;
+    size_t bytes = 0;
+    bool ok = false;
+    int64_t blocks = 0;          // heap blocks held by the DOM
+    int64_t requestedBytes = 0;  // asked for by the DOM (see footprint.cpp)
+    int64_t heapBytes = 0;       // usable size plus malloc's per-block header
+    uint64_t transientBytes = 0; // allocated and freed again during the parse
+    bool keepsInput = false;     // the input buffer must outlive the DOM
+    bool hasArena = false;
+    size_t arenaUsed = 0;
+    size_t arenaReserved = 0;
+
+    // Share of heapBytes that the parser did not ask for: block headers and
+    // size-class rounding.
+    double overhead() const;
+    // Heap bytes plus the pinned input, per byte of JSON.
+    double perJsonByte() const;
+};
+
+// Parses corpus once untimed to warm up the adapter, then again with
+// allocation tracking, and measures the resulting DOM before clearing it.
+Footprint measureFootprint(Adapter &adapter, const Corpus &corpus);
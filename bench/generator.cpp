@@ -0,0 +1,625 @@
+#include "generator.h"
+#include "random.h"
+
+#include <string.h>
+#include <vector>
+
+bool shapeFromName(const char *name, Shape &shape) {
+    static const char *const kNames[] = {"track", "tweet", "cyrillic", "geo"};
+    for (int i = 0; i <= SHAPE_GEO; ++i) {
+        if (!strcmp(name, kNames[i])) {
+            shape = Shape(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool whitespaceFromName(const char *name, WhitespaceStyle &style) {
+    static const char *const kNames[] = {"compact", "spaced", "pretty"};
+    for (int i = 0; i <= WHITESPACE_PRETTY; ++i) {
+        if (!strcmp(name, kNames[i])) {
+            style = WhitespaceStyle(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Buffered writer that tracks container nesting to place commas and
+// insignificant whitespace.
+class Emitter {
+    FILE *out;
+    WhitespaceStyle style;
+    std::string buf;
+    uint64_t flushed = 0;
+    bool failed = false;
+    std::vector<bool> hasItems;
+    bool afterKey = false;
+
+    void newline() {
+        buf += '\n';
+        buf.append(4 * hasItems.size(), ' ');
+    }
+    void separator() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (hasItems.empty())
+            return;
+        if (hasItems.back()) {
+            buf += ',';
+            if (style == WHITESPACE_SPACED)
+                buf += ' ';
+        }
+        hasItems.back() = true;
+        if (style == WHITESPACE_PRETTY)
+            newline();
+    }
+    void open(char c) {
+        separator();
+        buf += c;
+        hasItems.push_back(false);
+    }
+    void close(char c) {
+        bool items = hasItems.back();
+        hasItems.pop_back();
+        if (style == WHITESPACE_PRETTY && items)
+            newline();
+        buf += c;
+        if (buf.size() >= (1 << 20))
+            flush();
+    }
+
+public:
+    Emitter(FILE *out, WhitespaceStyle style)
+        : out(out), style(style) {
+    }
+    void beginObject() {
+        open('{');
+    }
+    void endObject() {
+        close('}');
+    }
+    void beginArray() {
+        open('[');
+    }
+    void endArray() {
+        close(']');
+    }
+    void key(const char *k) {
+        separator();
+        buf += '"';
+        buf += k;
+        buf += "\":";
+        if (style != WHITESPACE_COMPACT)
+            buf += ' ';
+        afterKey = true;
+    }
+    // s must already be valid JSON string content.
+    void string(const std::string &s) {
+        separator();
+        buf += '"';
+        buf += s;
+        buf += '"';
+    }
+    void integer(int64_t n) {
+        separator();
+        buf += std::to_string(n);
+    }
+    void real(double x, int precision = 15) {
+        char tmp[32];
+        snprintf(tmp, sizeof(tmp), "%.*g", precision, x);
+        separator();
+        buf += tmp;
+    }
+    void boolean(bool b) {
+        separator();
+        buf += b ? "true" : "false";
+    }
+    void null() {
+        separator();
+        buf += "null";
+    }
+    void endLine() {
+        buf += '\n';
+    }
+    uint64_t size() const {
+        return flushed + buf.size();
+    }
+    void flush() {
+        if (!buf.empty() && fwrite(buf.data(), 1, buf.size(), out) != buf.size())
+            failed = true;
+        flushed += buf.size();
+        buf.clear();
+    }
+    bool ok() const {
+        return !failed;
+    }
+};
+
+const char *const kLatinWords[] = {
+    "love", "night", "dance", "heart", "fire", "summer", "dream", "baby", "time", "world",
+    "Bailando", "Version", "Remix", "feat", "Radio", "Edit", "Live", "Acoustic", "Original", "Mix",
+    "Enrique", "Iglesias", "Pharrell", "Williams", "Happy", "Shakira", "Sia", "Chandelier", "Maroon", "Sugar",
+};
+
+const char *const kTweetWords[] = {
+    "no", "te", "perdiste", "de", "nada", "bueno", "hoy", "quiero", "tiempo", "oro",
+    "the", "new", "blog", "post", "check", "out", "via", "#music", "#news", "lol",
+    "@nhgdesign", "@musixmatch", "http://t.co/x1Yz", "RT", "thanks", "great", "day", "tonight", "mañana", "señor",
+};
+
+const char *const kCyrillicFirst[] = {
+    "Юрий", "Валерий", "Парамон", "Александр", "Дмитрий", "Людвиг", "Роман", "Игнат",
+    "Николай", "Сергей", "Фёдор", "Олег", "Пётр", "Борис", "Евгений", "Аркадий",
+};
+
+const char *const kCyrillicLast[] = {
+    "Титов", "Васильев", "Белов", "Иванов", "Фролов", "Сергеев", "Чернов", "Волков",
+    "Смирнов", "Кузнецов", "Попов", "Соколов", "Лебедев", "Козлов", "Новиков", "Морозов",
+};
+
+const char *const kGenres[] = {"Pop", "Pop Latino", "Dance", "Rock", "Hip Hop/Rap", "R&B/Soul", "Alternative", "Electronic"};
+const char *const kLanguages[] = {"es", "en", "it", "pt", "fr", "ru"};
+const char *const kTimeZones[] = {"Hawaii", "Rome", "Madrid", "Quito", "London", "Moscow"};
+const char *const kColors[] = {"140e13", "1f181d", "75e3ff", "405ed6", "f5f5f5", "C0DEED", "333333"};
+
+class Generator {
+    const GeneratorOptions &options;
+    Random rng;
+    Emitter out;
+    double escapeDensity;
+    double unicodeDensity;
+    int64_t serial = 0;
+
+    void appendCodePoint(std::string &s, unsigned c) {
+        if (c < 0x80) {
+            s += (char)c;
+        } else if (c < 0x800) {
+            s += (char)(0xC0 | (c >> 6));
+            s += (char)(0x80 | (c & 0x3F));
+        } else {
+            s += (char)(0xE0 | (c >> 12));
+            s += (char)(0x80 | ((c >> 6) & 0x3F));
+            s += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    void appendEscape(std::string &s, char original) {
+        static const char kHex[] = "0123456789abcdef";
+        switch (rng.below(6)) {
+        case 0:
+            s += "\\\"";
+            break;
+        case 1:
+            s += "\\\\";
+            break;
+        case 2:
+            s += "\\/";
+            break;
+        case 3:
+            s += "\\n";
+            break;
+        case 4:
+            s += "\\t";
+            break;
+        default: {
+            unsigned c = rng.chance(0.5) ? (unsigned char)original : 0x400 + (unsigned)rng.below(0x60);
+            s += "\\u";
+            for (int shift = 12; shift >= 0; shift -= 4)
+                s += kHex[(c >> shift) & 0xF];
+        }
+        }
+    }
+
+    // Copies plain UTF-8 text into JSON string content, sprinkling escapes
+    // and non-ASCII letters at the configured densities.
+    std::string text(const std::string &plain) {
+        std::string s;
+        s.reserve(plain.size() + 8);
+        for (char c : plain) {
+            if ((unsigned char)c >= 0x80) {
+                s += c; // leave existing multi-byte sequences intact
+            } else if (c == '"' || c == '\\') {
+                s += '\\';
+                s += c;
+            } else if (rng.chance(escapeDensity)) {
+                appendEscape(s, c);
+            } else if (((c | ' ') >= 'a' && (c | ' ') <= 'z') && rng.chance(unicodeDensity)) {
+                appendCodePoint(s, rng.chance(0.9) ? 0x410 + (unsigned)rng.below(0x40) : 0x4E00 + (unsigned)rng.below(0x200));
+            } else {
+                s += c;
+            }
+        }
+        return s;
+    }
+
+    template <size_t N>
+    std::string sentence(const char *const (&words)[N], int count) {
+        std::string s;
+        for (int i = 0; i < count; ++i) {
+            if (i)
+                s += ' ';
+            s += rng.pick(words);
+        }
+        return s;
+    }
+
+    std::string slug(const std::string &plain) {
+        std::string s;
+        for (char c : plain)
+            s += c == ' ' ? '-' : c;
+        return s;
+    }
+
+    bool asString() {
+        return options.stringRatio >= 0 && rng.chance(options.stringRatio);
+    }
+    bool asNumber() {
+        return options.stringRatio >= 0 && !rng.chance(options.stringRatio);
+    }
+
+    void field(const char *key, int64_t n) {
+        out.key(key);
+        if (asString())
+            out.string(std::to_string(n));
+        else
+            out.integer(n);
+    }
+    void field(const char *key, double x) {
+        out.key(key);
+        if (asString()) {
+            char tmp[32];
+            snprintf(tmp, sizeof(tmp), "%.15g", x);
+            out.string(tmp);
+        } else {
+            out.real(x);
+        }
+    }
+    void field(const char *key, const std::string &plain) {
+        out.key(key);
+        if (asNumber())
+            out.integer(rng.range(0, 99999999));
+        else
+            out.string(text(plain));
+    }
+    void flag(const char *key, bool b) {
+        out.key(key);
+        out.boolean(b);
+    }
+    void nullField(const char *key) {
+        out.key(key);
+        out.null();
+    }
+
+    void nested(int remaining) {
+        if (remaining == 0) {
+            out.string(text(sentence(kLatinWords, 2)));
+        } else if (remaining % 2) {
+            out.beginArray();
+            out.integer(rng.range(0, 1000));
+            nested(remaining - 1);
+            out.endArray();
+        } else {
+            out.beginObject();
+            field("level", (int64_t)remaining);
+            out.key("child");
+            nested(remaining - 1);
+            out.endObject();
+        }
+    }
+    void nestedField() {
+        if (options.depth > 0) {
+            out.key("nested");
+            nested(options.depth);
+        }
+    }
+
+    void genres(const char *key) {
+        out.key(key);
+        out.beginObject();
+        out.key("music_genre_list");
+        out.beginArray();
+        for (int64_t i = rng.range(0, 2); i > 0; --i) {
+            std::string name = rng.pick(kGenres);
+            out.beginObject();
+            out.key("music_genre");
+            out.beginObject();
+            field("music_genre_id", rng.range(1, 1200));
+            field("music_genre_parent_id", rng.range(0, 40));
+            field("music_genre_name", name);
+            field("music_genre_name_extended", name);
+            field("music_genre_vanity", slug(name));
+            out.endObject();
+            out.endObject();
+        }
+        out.endArray();
+        out.endObject();
+    }
+
+    void track() {
+        std::string name = sentence(kLatinWords, (int)rng.range(1, 4));
+        std::string artist = sentence(kLatinWords, (int)rng.range(1, 3));
+        std::string album = sentence(kLatinWords, (int)rng.range(1, 3));
+        int64_t albumArt = rng.range(10000000, 39999999);
+        std::string art = "http://static.musixmatch.com/images-storage/albums8/7/0/0/8/5/7/" + std::to_string(albumArt);
+        std::string share = "https://community.musixmatch.com/lyrics/" + slug(artist) + "/" + slug(name);
+
+        out.beginObject();
+        out.key("track");
+        out.beginObject();
+        field("track_id", rng.range(10000000, 99999999));
+        field("track_mbid", std::string());
+        field("track_isrc", "GBUM7" + std::to_string(rng.range(1000000, 9999999)));
+        field("track_spotify_id", std::string());
+        field("track_soundcloud_id", (int64_t)0);
+        field("track_xboxmusic_id", std::string());
+        field("track_name", name);
+        out.key("track_name_translation_list");
+        out.beginArray();
+        out.endArray();
+        field("track_rating", rng.range(1, 100));
+        field("track_length", rng.range(90, 420));
+        field("commontrack_id", rng.range(10000000, 99999999));
+        field("instrumental", rng.range(0, 1));
+        field("explicit", rng.range(0, 1));
+        field("has_lyrics", rng.range(0, 1));
+        field("has_subtitles", rng.range(0, 1));
+        field("num_favourite", rng.range(0, 5000));
+        field("lyrics_id", rng.range(1000000, 9999999));
+        field("subtitle_id", rng.range(1000000, 9999999));
+        field("album_id", rng.range(10000000, 99999999));
+        field("album_name", album);
+        field("artist_id", rng.range(100000, 99999999));
+        field("artist_mbid", std::string());
+        field("artist_name", artist);
+        field("album_coverart_100x100", art + ".jpg");
+        field("album_coverart_350x350", art + "_350_350.jpg");
+        field("album_coverart_500x500", art + "_500_500.jpg");
+        field("album_coverart_800x800", art + "_800_800.jpg");
+        field("track_share_url", share);
+        field("track_edit_url", share + "?utm_source=application&utm_campaign=api&utm_medium=musixmatch-iphone");
+        field("commontrack_vanity_id", slug(artist) + "/" + slug(name));
+        field("updated_time", "2014-0" + std::to_string(rng.range(1, 9)) + "-2" + std::to_string(rng.range(0, 8)) + "T08:55:26Z");
+        genres("primary_genres");
+        genres("secondary_genres");
+        nestedField();
+        out.endObject();
+        out.endObject();
+    }
+
+    void user() {
+        std::string screenName = slug(sentence(kTweetWords, 1)) + std::to_string(rng.range(1, 999));
+        int64_t id = rng.range(10000000, 999999999);
+        out.key("user");
+        out.beginObject();
+        field("profile_link_color", std::string(rng.pick(kColors)));
+        flag("protected", rng.chance(0.1));
+        flag("default_profile_image", rng.chance(0.2));
+        nullField("following");
+        field("created_at", std::string("Sat Apr 03 17:18:50 +0000 2010"));
+        field("friends_count", rng.range(0, 5000));
+        field("name", sentence(kLatinWords, 2));
+        nullField("notifications");
+        field("profile_background_color", std::string(rng.pick(kColors)));
+        flag("is_translator", false);
+        field("statuses_count", rng.range(0, 100000));
+        field("utc_offset", rng.range(-12, 12) * 3600);
+        field("description", sentence(kTweetWords, (int)rng.range(0, 24)));
+        field("favourites_count", rng.range(0, 1000));
+        field("profile_sidebar_fill_color", std::string(rng.pick(kColors)));
+        flag("geo_enabled", rng.chance(0.3));
+        field("location", sentence(kTweetWords, (int)rng.range(0, 4)));
+        field("lang", std::string(rng.pick(kLanguages)));
+        field("profile_image_url_https", "https://si0.twimg.com/profile_images/" + std::to_string(id) + "/avatar_normal.jpg");
+        field("screen_name", screenName);
+        field("listed_count", rng.range(0, 200));
+        flag("verified", rng.chance(0.05));
+        field("time_zone", std::string(rng.pick(kTimeZones)));
+        field("id", id);
+        field("id_str", std::to_string(id));
+        field("followers_count", rng.range(0, 100000));
+        out.endObject();
+    }
+
+    void tweet() {
+        int64_t id = rng.range(100000000000000000LL, 999999999999999999LL);
+        out.beginObject();
+        field("retweet_count", rng.range(0, 100));
+        nullField("in_reply_to_user_id");
+        flag("favorited", rng.chance(0.1));
+        field("created_at", "Tue Dec 0" + std::to_string(rng.range(1, 9)) + " 22:21:26 +0000 2011");
+        nullField("in_reply_to_screen_name");
+        nullField("in_reply_to_status_id");
+        user();
+        flag("retweeted", rng.chance(0.1));
+        flag("truncated", false);
+        out.key("entities");
+        out.beginObject();
+        out.key("urls");
+        out.beginArray();
+        out.endArray();
+        out.key("hashtags");
+        out.beginArray();
+        out.endArray();
+        out.key("user_mentions");
+        out.beginArray();
+        for (int64_t i = rng.range(0, 2); i > 0; --i) {
+            int64_t mentionId = rng.range(1000000, 99999999);
+            int64_t at = rng.range(0, 100);
+            out.beginObject();
+            field("name", sentence(kLatinWords, 2));
+            out.key("indices");
+            out.beginArray();
+            out.integer(at);
+            out.integer(at + rng.range(4, 15));
+            out.endArray();
+            field("screen_name", slug(sentence(kLatinWords, 1)));
+            field("id", mentionId);
+            field("id_str", std::to_string(mentionId));
+            out.endObject();
+        }
+        out.endArray();
+        out.endObject();
+        nullField("place");
+        nullField("geo");
+        field("source", std::string("<a href=\"http://ubersocial.com\" rel=\"nofollow\">UberSocial for BlackBerry</a>"));
+        nullField("contributors");
+        nullField("coordinates");
+        field("id", id);
+        field("id_str", std::to_string(id));
+        field("text", sentence(kTweetWords, (int)rng.range(3, 22)));
+        nestedField();
+        out.endObject();
+    }
+
+    void cyrillic() {
+        std::string name = std::string(rng.pick(kCyrillicFirst)) + " " + rng.pick(kCyrillicLast);
+        out.beginObject();
+        field("id", ++serial);
+        field("name", name);
+        nestedField();
+        out.endObject();
+    }
+
+    // Coordinates in the full round-trip precision GIS exports use, next to
+    // short measurements and the occasional exponent.
+    void coordinate(double lon, double lat) {
+        out.beginArray();
+        out.real(lon, 17);
+        out.real(lat, 17);
+        out.endArray();
+    }
+
+    void geo() {
+        double lon = (double)rng.range(-180000000, 180000000) / 1e6 + (double)rng.below(1000000) / 1e13;
+        double lat = (double)rng.range(-85000000, 85000000) / 1e6 + (double)rng.below(1000000) / 1e13;
+        out.beginObject();
+        field("type", std::string("Feature"));
+        field("id", ++serial);
+        out.key("properties");
+        out.beginObject();
+        field("elevation", (double)rng.range(-4000, 88480) / 10);
+        field("temperature", (double)rng.range(-500, 500) / 10);
+        field("pressure", (double)rng.range(87000, 108500) / 100);
+        field("density", (double)rng.range(1, 9999) * 1e-9);
+        field("weight", (double)rng.below(1000000000) / 1e9);
+        nestedField();
+        out.endObject();
+        out.key("geometry");
+        out.beginObject();
+        field("type", std::string("LineString"));
+        out.key("coordinates");
+        out.beginArray();
+        for (int64_t i = rng.range(2, 12); i > 0; --i) {
+            coordinate(lon, lat);
+            lon += (double)rng.range(-5000, 5000) / 1e6 + (double)rng.below(1000000) / 1e13;
+            lat += (double)rng.range(-5000, 5000) / 1e6 + (double)rng.below(1000000) / 1e13;
+        }
+        out.endArray();
+        out.endObject();
+        out.endObject();
+    }
+
+    void record() {
+        switch (options.shape) {
+        case SHAPE_TRACK:
+            track();
+            break;
+        case SHAPE_TWEET:
+            tweet();
+            break;
+        case SHAPE_CYRILLIC:
+            cyrillic();
+            break;
+        case SHAPE_GEO:
+            geo();
+            break;
+        }
+    }
+
+    void records() {
+        do
+            record();
+        while (out.size() < options.targetBytes);
+    }
+
+public:
+    Generator(const GeneratorOptions &options, FILE *file)
+        : options(options), rng(options.seed),
+          out(file, options.ndjson && options.whitespace == WHITESPACE_PRETTY ? WHITESPACE_SPACED : options.whitespace) {
+        static const double kEscapeDensity[] = {0, 0.003, 0, 0};
+        static const double kUnicodeDensity[] = {0, 0.01, 0, 0};
+        escapeDensity = options.escapeDensity >= 0 ? options.escapeDensity : kEscapeDensity[options.shape];
+        unicodeDensity = options.unicodeDensity >= 0 ? options.unicodeDensity : kUnicodeDensity[options.shape];
+    }
+
+    uint64_t run() {
+        if (options.ndjson) {
+            do {
+                record();
+                out.endLine();
+            } while (out.size() < options.targetBytes);
+        } else if (options.shape == SHAPE_TRACK) {
+            out.beginObject();
+            out.key("message");
+            out.beginObject();
+            out.key("header");
+            out.beginObject();
+            out.key("status_code");
+            out.integer(200);
+            out.key("execute_time");
+            out.real(0.042984008789062);
+            out.key("maintenance_id");
+            out.integer(0);
+            out.endObject();
+            out.key("body");
+            out.beginObject();
+            out.key("track_list");
+            out.beginArray();
+            records();
+            out.endArray();
+            out.endObject();
+            out.endObject();
+            out.endObject();
+        } else if (options.shape == SHAPE_GEO) {
+            out.beginObject();
+            out.key("type");
+            out.string("FeatureCollection");
+            out.key("features");
+            out.beginArray();
+            records();
+            out.endArray();
+            out.endObject();
+        } else if (options.shape == SHAPE_TWEET) {
+            out.beginArray();
+            records();
+            out.endArray();
+        } else {
+            out.beginObject();
+            out.key("id");
+            out.integer(1);
+            out.key("jsonrpc");
+            out.string("2.0");
+            out.key("result");
+            out.beginArray();
+            records();
+            out.endArray();
+            out.key("total");
+            out.integer(serial);
+            out.endObject();
+        }
+        out.flush();
+        return out.ok() ? out.size() : 0;
+    }
+};
+
+} // namespace
+
+uint64_t generateCorpus(const GeneratorOptions &options, FILE *out) {
+    return Generator(options, out).run();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+// Record shapes modelled on the bundled corpora.
+enum Shape {
+    SHAPE_TRACK,    // track_list entries of track.chart.get.json
+    SHAPE_TWEET,    // statuses of twitter_timeline.json
+    SHAPE_CYRILLIC, // {"id", "name"} records of repeat.json
+    SHAPE_GEO,      // GeoJSON features, almost all floating-point numbers
+};
+
+enum WhitespaceStyle {
+    WHITESPACE_COMPACT, // no insignificant whitespace
+    WHITESPACE_SPACED,  // one space after ':' and ','
+    WHITESPACE_PRETTY,  // newline and four-space indent per level
+};
+
+bool shapeFromName(const char *name, Shape &shape);
+bool whitespaceFromName(const char *name, WhitespaceStyle &style);
+
+struct GeneratorOptions {
+    Shape shape = SHAPE_TRACK;
+    uint64_t targetBytes = 1 << 20;
+    // One compact record per line instead of a single document wrapping
+    // all records the way the original corpus does. Pretty output is
+    // downgraded to spaced, since NDJSON records cannot span lines.
+    bool ndjson = false;
+    // Extra levels of nested objects and arrays added to every record.
+    int depth = 0;
+    // Probability that a scalar field is emitted as a string rather than
+    // a number; negative keeps the shape's own typing.
+    double stringRatio = -1;
+    // Per-character probability of an escape sequence inside strings.
+    double escapeDensity = -1;
+    // Per-character probability of replacing an ASCII letter with a
+    // multi-byte UTF-8 character.
+    double unicodeDensity = -1;
+    WhitespaceStyle whitespace = WHITESPACE_COMPACT;
+    uint64_t seed = 1;
+};
+
+// Writes records until at least targetBytes have been produced, then closes
+// the document. Output depends only on the options, never on the platform.
+// Returns the number of bytes written, or 0 on a write error.
+uint64_t generateCorpus(const GeneratorOptions &options, FILE *out);
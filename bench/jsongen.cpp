@@ -0,0 +1,130 @@
+#include "generator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "\n"
+            "Writes a synthetic corpus shaped like the bundled documents.\n"
+            "\n"
+            "options:\n"
+            "  -s, --shape NAME          track, tweet, cyrillic or geo (default track)\n"
+            "  -b, --size BYTES          target size, with optional K, M or G suffix (default 1M)\n"
+            "      --ndjson              one record per line instead of one document\n"
+            "      --depth N             extra nesting levels per record (default 0)\n"
+            "      --string-ratio R      probability that a scalar is a string (default: shape's own)\n"
+            "      --escape-density P    per-character probability of an escape sequence\n"
+            "      --unicode-density P   per-character probability of a non-ASCII letter\n"
+            "      --whitespace STYLE    compact, spaced or pretty (default compact)\n"
+            "      --seed N              random seed (default 1)\n"
+            "  -o, --output FILE         write to FILE instead of stdout\n"
+            "  -h, --help                show this help\n",
+            argv0);
+}
+
+static bool parseSize(const char *arg, uint64_t &bytes) {
+    char *end;
+    unsigned long long n = strtoull(arg, &end, 10);
+    if (end == arg)
+        return false;
+    switch (*end) {
+    case 'K':
+    case 'k':
+        n <<= 10;
+        ++end;
+        break;
+    case 'M':
+    case 'm':
+        n <<= 20;
+        ++end;
+        break;
+    case 'G':
+    case 'g':
+        n <<= 30;
+        ++end;
+        break;
+    }
+    if (*end != '\0' || n == 0)
+        return false;
+    bytes = n;
+    return true;
+}
+
+static bool parseProbability(const char *arg, double &p) {
+    char *end;
+    p = strtod(arg, &end);
+    return end != arg && *end == '\0' && p >= 0 && p <= 1;
+}
+
+int main(int argc, char **argv) {
+    GeneratorOptions options;
+    const char *output = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+            usage(argv[0]);
+            return 0;
+        } else if (!strcmp(arg, "--ndjson")) {
+            options.ndjson = true;
+            continue;
+        } else if (!value) {
+            ok = false;
+        } else if (!strcmp(arg, "-s") || !strcmp(arg, "--shape")) {
+            ok = shapeFromName(value, options.shape);
+        } else if (!strcmp(arg, "-b") || !strcmp(arg, "--size")) {
+            ok = parseSize(value, options.targetBytes);
+        } else if (!strcmp(arg, "--depth")) {
+            char *end;
+            long depth = strtol(value, &end, 10);
+            ok = end != value && *end == '\0' && depth >= 0 && depth <= 1000;
+            options.depth = (int)depth;
+        } else if (!strcmp(arg, "--string-ratio")) {
+            ok = parseProbability(value, options.stringRatio);
+        } else if (!strcmp(arg, "--escape-density")) {
+            ok = parseProbability(value, options.escapeDensity);
+        } else if (!strcmp(arg, "--unicode-density")) {
+            ok = parseProbability(value, options.unicodeDensity);
+        } else if (!strcmp(arg, "--whitespace")) {
+            ok = whitespaceFromName(value, options.whitespace);
+        } else if (!strcmp(arg, "--seed")) {
+            char *end;
+            options.seed = strtoull(value, &end, 10);
+            ok = end != value && *end == '\0';
+        } else if (!strcmp(arg, "-o") || !strcmp(arg, "--output")) {
+            output = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            if (value)
+                fprintf(stderr, "bad argument: %s %s\n", arg, value);
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+
+    FILE *out = output ? fopen(output, "wb") : stdout;
+    if (!out) {
+        fprintf(stderr, "cannot open %s\n", output);
+        return 1;
+    }
+    uint64_t written = generateCorpus(options, out);
+    if (fflush(out) != 0)
+        written = 0;
+    if (output && fclose(out) != 0)
+        written = 0;
+    if (written == 0) {
+        fprintf(stderr, "write failed\n");
+        return 1;
+    }
+    if (output)
+        fprintf(stderr, "%s: %llu bytes\n", output, (unsigned long long)written);
+    return 0;
+}
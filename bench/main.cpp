@@ -0,0 +1,642 @@
+#include "adapters.h"
+#include "baseline.h"
+#include "corpus.h"
+#include "footprint.h"
+#include "query.h"
+#include "report.h"
+#include "runner.h"
+#include "scaling.h"
+#include "startup.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [options] [file.json ...]\n"
+            "\n"
+            "Without files, the corpora bundled in " JSONBENCH_CORPUS_DIR " are used;\n"
+            "bare file names are looked up there too.\n"
+            "\n"
+            "options:\n"
+            "  -l, --library NAME     benchmark only NAME (repeatable)\n"
+            "  -n, --iterations N     timed iterations per document (default 100)\n"
+            "  -w, --warmup N         untimed warmup iterations (default 10)\n"
+            "  -W, --workload NAME    parse, walk, dump, pretty or all (default parse,\n"
+            "                         repeatable)\n"
+            "      --serialize        writer suite: dump and pretty with output\n"
+            "                         throughput and allocations per dump\n"
+            "      --perf             record hardware counters (Linux perf_event_open)\n"
+            "      --allocs           count heap allocations per parse and teardown\n"
+            "      --reuse            let adapters keep allocators across parses\n"
+            "      --assert-steady    with --reuse: fail if a reusing adapter still\n"
+            "                         allocates after warmup (implies --allocs --reuse)\n"
+            "      --footprint        report the memory held by each parsed DOM\n"
+            "                         instead of timing\n"
+            "      --startup          spawn a fresh process per measurement and time\n"
+            "                         the first parsed document (-n processes)\n"
+            "      --query            time point, path, missing-key and iteration\n"
+            "                         lookups on parsed DOMs instead of parsing\n"
+            "      --save FILE        store raw samples as a JSON baseline\n"
+            "      --baseline FILE    compare against a stored baseline; significant\n"
+            "                         regressions make the run fail\n"
+            "      --threshold PCT    smallest change worth reporting (default 2)\n"
+            "  -c, --cache MODE       hot, evict, mmap, fresh or all (default hot,\n"
+            "                         repeatable); see README\n"
+            "      --report FILE      write an HTML report with latency histograms,\n"
+            "                         CDFs and baseline diffs\n"
+            "  -j, --threads N        run 1, 2, 4 .. N threads in parallel, each with its\n"
+            "                         own parser, and report scaling (N=0: all cores)\n"
+            "      --list             list available libraries\n"
+            "  -h, --help             show this help\n",
+            argv0);
+}
+
+static void printResult(const RunResult &r) {
+    std::string label = r.label();
+    const char *workload = label.c_str();
+    if (!r.supported) {
+        printf("%-26s %-10s %-12s %10zu %12s\n", r.corpus.c_str(), r.library.c_str(), workload, r.bytes, "unsupported");
+        return;
+    }
+    if (!r.ok) {
+        printf("%-26s %-10s %-12s %10zu %12s\n", r.corpus.c_str(), r.library.c_str(), workload, r.bytes, "parse error");
+        return;
+    }
+    char phase[32] = "-";
+    if (r.workload != WORKLOAD_PARSE)
+        snprintf(phase, sizeof(phase), "%.0f", summarize(r.phaseNs).median);
+    Summary total = summarize(r.totalNs());
+    double ci = total.median > 0 ? 50 * (total.medianHigh - total.medianLow) / total.median : 0;
+    printf("%-26s %-10s %-12s %10zu %12.0f %12s %12.0f %6.1f%% %12.0f %12.0f %10.1f\n",
+           r.corpus.c_str(), r.library.c_str(), workload, r.bytes,
+           summarize(r.parseNs).median, phase, total.median, ci, total.p90, total.p99, r.mbPerSec());
+}
+
+static const char *verdictName(Verdict v) {
+    return v == VERDICT_SLOWER ? "SLOWER" : v == VERDICT_FASTER ? "faster" : "same";
+}
+
+// Compares median and p90 of the total time against the baseline and
+// returns the number of significant regressions.
+static int printComparison(const std::vector<RunResult> &results, const std::vector<RunResult> &baseline,
+                           double threshold) {
+    int regressions = 0;
+    printf("\n%-26s %-10s %-12s %12s %12s %22s %7s %22s %7s\n",
+           "corpus", "library", "work", "base median", "median", "median ratio [95% CI]", "", "p90 ratio [95% CI]", "");
+    for (const RunResult &r : results) {
+        const RunResult *base = r.ok ? findResult(baseline, r) : nullptr;
+        if (!base)
+            continue;
+        std::vector<uint64_t> before = base->totalNs(), after = r.totalNs();
+        Comparison median = comparePercentile(before, after, 50, threshold);
+        Comparison p90 = comparePercentile(before, after, 90, threshold);
+        printf("%-26s %-10s %-12s %12.0f %12.0f %6.3f [%6.3f, %6.3f] %7s %6.3f [%6.3f, %6.3f] %7s\n",
+               r.corpus.c_str(), r.library.c_str(), r.label().c_str(),
+               summarize(before).median, summarize(after).median,
+               median.ratio, median.low, median.high, verdictName(median.verdict),
+               p90.ratio, p90.low, p90.high, verdictName(p90.verdict));
+        regressions += median.verdict == VERDICT_SLOWER || p90.verdict == VERDICT_SLOWER;
+    }
+    return regressions;
+}
+
+static void printPerfValue(const PerfReading &perf, int event, int iterations) {
+    if (perf.valid[event])
+        printf(" %12.1f", (double)perf.count[event] / iterations);
+    else
+        printf(" %12s", "n/a");
+}
+
+// Each cold-cache result against the hot run of the same library, corpus
+// and workload.
+static void printCacheTable(const std::vector<RunResult> &results) {
+    printf("\n%-26s %-10s %-12s %12s %12s %12s %8s %12s\n",
+           "corpus", "library", "work", "hot ns", "cold ns", "delta ns", "ratio", "faults/doc");
+    for (const RunResult &r : results) {
+        if (!r.ok || r.cache == CACHE_HOT)
+            continue;
+        const RunResult *hot = nullptr;
+        for (const RunResult &h : results) {
+            if (h.ok && h.cache == CACHE_HOT && h.library == r.library && h.corpus == r.corpus &&
+                h.workload == r.workload)
+                hot = &h;
+        }
+        double cold = summarize(r.totalNs()).median;
+        double faults = (double)r.minorFaults / r.parseNs.size();
+        if (!hot) {
+            printf("%-26s %-10s %-12s %12s %12.0f %12s %8s %12.1f\n", r.corpus.c_str(), r.library.c_str(),
+                   r.label().c_str(), "-", cold, "-", "-", faults);
+            continue;
+        }
+        double warm = summarize(hot->totalNs()).median;
+        printf("%-26s %-10s %-12s %12.0f %12.0f %12.0f %7.2fx %12.1f\n", r.corpus.c_str(), r.library.c_str(),
+               r.label().c_str(), warm, cold, cold - warm, warm > 0 ? cold / warm : 0, faults);
+    }
+}
+
+// Writer throughput in serialized bytes per second of the dump phase alone,
+// with the heap traffic of each dump.
+static void printSerializeTable(const std::vector<RunResult> &results) {
+    printf("\n%-26s %-10s %-12s %12s %12s %10s %10s %12s\n",
+           "corpus", "library", "work", "out bytes", "dump ns", "out MB/s", "allocs", "alloc bytes");
+    for (const RunResult &r : results) {
+        if (!r.ok || r.workload < WORKLOAD_DUMP)
+            continue;
+        double n = (double)r.phaseNs.size();
+        printf("%-26s %-10s %-12s %12zu %12.0f %10.1f %10.1f %12.1f\n", r.corpus.c_str(), r.library.c_str(),
+               r.label().c_str(), r.outputBytes, summarize(r.phaseNs).median, r.outputMbPerSec(),
+               r.phaseAllocs.allocs / n, r.phaseAllocs.bytes / n);
+    }
+}
+
+// Counter values are per document; IPC and bytes/cycle are derived from
+// cycles and instructions over both phases of the workload.
+static void printPerfTable(const std::vector<RunResult> &results) {
+    printf("\n%-26s %-10s %-12s", "corpus", "library", "work");
+    for (int e = 0; e < PERF_EVENTS; ++e)
+        printf(" %12s", perfEventName(e));
+    printf(" %8s %11s\n", "IPC", "bytes/cycle");
+    for (const RunResult &r : results) {
+        if (!r.ok || !r.perf.any())
+            continue;
+        int iterations = (int)r.parseNs.size();
+        printf("%-26s %-10s %-12s", r.corpus.c_str(), r.library.c_str(), r.label().c_str());
+        for (int e = 0; e < PERF_EVENTS; ++e)
+            printPerfValue(r.perf, e, iterations);
+        double ipc = r.perf.ratio(PERF_INSTRUCTIONS, PERF_CYCLES);
+        if (ipc >= 0)
+            printf(" %8.2f", ipc);
+        else
+            printf(" %8s", "n/a");
+        if (r.perf.valid[PERF_CYCLES] && r.perf.count[PERF_CYCLES])
+            printf(" %11.3f\n", (double)r.bytes * iterations / r.perf.count[PERF_CYCLES]);
+        else
+            printf(" %11s\n", "n/a");
+    }
+}
+
+// Per-document averages of the timed iterations; peak is the highest live
+// heap growth seen during any single parse.
+static void printAllocTable(const std::vector<RunResult> &results) {
+    printf("\n%-26s %-10s %-12s %12s %12s %12s %10s %12s %12s %12s %8s\n",
+           "corpus", "library", "work", "parse allocs", "parse bytes", "parse frees", "peak KB",
+           "phase allocs", "tear allocs", "tear frees", "reuse");
+    for (const RunResult &r : results) {
+        if (!r.ok)
+            continue;
+        double n = (double)r.parseNs.size();
+        printf("%-26s %-10s %-12s %12.1f %12.1f %12.1f %10.1f %12.1f %12.1f %12.1f %8s\n",
+               r.corpus.c_str(), r.library.c_str(), r.label().c_str(),
+               r.parseAllocs.allocs / n, r.parseAllocs.bytes / n, r.parseAllocs.frees / n,
+               r.parseAllocs.peak / 1024.0, r.phaseAllocs.allocs / n,
+               r.teardownAllocs.allocs / n, r.teardownAllocs.frees / n, r.reused ? "yes" : "no");
+    }
+}
+
+// Every adapter that accepted reuse must not touch the heap after warmup.
+static int checkSteadyState(const std::vector<RunResult> &results) {
+    int failures = 0;
+    fflush(stdout);
+    for (const RunResult &r : results) {
+        if (!r.ok || !r.reused)
+            continue;
+        uint64_t allocs = r.parseAllocs.allocs + r.phaseAllocs.allocs + r.teardownAllocs.allocs;
+        if (allocs) {
+            fprintf(stderr, "%s: %s %s allocated %llu times after warmup despite reuse\n",
+                    r.corpus.c_str(), r.library.c_str(), r.label().c_str(), (unsigned long long)allocs);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// Memory held by one parsed document. Overhead is the part of the heap
+// bytes the parser did not request; "total/JSON" adds the input buffer for
+// parsers whose DOM points into it; arena is the share of the arena handed
+// out to the DOM; transient bytes were freed again before parse returned.
+static int printFootprintTable(const std::vector<const AdapterInfo *> &selected, const std::vector<Corpus> &corpora) {
+    int failures = 0;
+    printf("%-26s %-10s %10s %10s %12s %10s %8s %6s %10s %7s %12s\n", "corpus", "library", "bytes", "blocks",
+           "requested KB", "heap KB", "overhead", "input", "total/JSON", "arena", "transient KB");
+    for (const Corpus &corpus : corpora) {
+        for (const AdapterInfo *info : selected) {
+            std::unique_ptr<Adapter> adapter = info->create();
+            Footprint f = measureFootprint(*adapter, corpus);
+            if (!f.ok) {
+                printf("%-26s %-10s %10zu %10s\n", f.corpus.c_str(), f.library.c_str(), f.bytes, "parse error");
+                ++failures;
+                continue;
+            }
+            char arena[16] = "-";
+            if (f.hasArena && f.arenaReserved)
+                snprintf(arena, sizeof(arena), "%.0f%%", 100.0 * f.arenaUsed / f.arenaReserved);
+            printf("%-26s %-10s %10zu %10lld %12.1f %10.1f %7.1f%% %6s %10.2f %7s %12.1f\n", f.corpus.c_str(),
+                   f.library.c_str(), f.bytes, (long long)f.blocks, f.requestedBytes / 1024.0, f.heapBytes / 1024.0,
+                   100 * f.overhead(), f.keepsInput ? "kept" : "-", f.perJsonByte(), arena,
+                   f.transientBytes / 1024.0);
+        }
+    }
+    return failures;
+}
+
+static const int kQueryWidths[] = {4, 8, 16, 64, 256, 1024};
+
+static int printQueryRow(Adapter &adapter, const char *name, QueryPattern pattern, const Corpus &track, bool haveTrack,
+                         const RunOptions &options) {
+    int failures = 0;
+    printf("%-8s %-15s", queryPatternName(pattern), name);
+    for (int width : kQueryWidths) {
+        QuerySet set;
+        wideQueries(width, pattern, set);
+        QueryResult r = runQuery(adapter, wideDocument(width), set, options.warmup, options.iterations);
+        failures += !r.ok;
+        if (r.ok)
+            printf(" %13.1f", r.nsPerAccess());
+        else
+            printf(" %13s", "FAILED");
+    }
+    QuerySet set;
+    if (haveTrack && (pattern == QUERY_PATH || pattern == QUERY_MISSING) && trackQueries(track, pattern, set)) {
+        QueryResult r = runQuery(adapter, track, set, options.warmup, options.iterations);
+        failures += !r.ok;
+        if (r.ok)
+            printf(" %12.1f", r.nsPerAccess());
+        else
+            printf(" %12s", "FAILED");
+    } else {
+        printf(" %12s", "-");
+    }
+    printf("\n");
+    return failures;
+}
+
+// ns per lookup against objects of growing width, and along the real
+// track_list path of track.chart.get.json. For iterate, an access is one
+// member visited.
+static int printQueryTable(const std::vector<const AdapterInfo *> &selected, const RunOptions &options) {
+    Corpus track;
+    bool haveTrack = loadCorpus(JSONBENCH_CORPUS_DIR "/track.chart.get.json", track);
+
+    int failures = 0;
+    printf("%-8s %-15s", "pattern", "library");
+    for (int width : kQueryWidths)
+        printf(" %9s%-4d", "w=", width);
+    printf(" %12s\n", "track");
+    for (int p = 0; p < QUERY_PATTERNS; ++p) {
+        QueryPattern pattern = QueryPattern(p);
+        for (const AdapterInfo *info : selected) {
+            std::unique_ptr<Adapter> adapter = info->create();
+            failures += printQueryRow(*adapter, info->name, pattern, track, haveTrack, options);
+            // Libraries with an optional lookup index get a second row, so
+            // the width where it starts to pay off can be read off the table.
+            if (adapter->setLookupIndex(true))
+                failures += printQueryRow(*adapter, (std::string(info->name) + "+index").c_str(), pattern, track,
+                                          haveTrack, options);
+        }
+    }
+    return failures;
+}
+
+static double medianOf(const std::vector<StartupSample> &samples, uint64_t StartupSample::*field) {
+    std::vector<uint64_t> values;
+    for (const StartupSample &s : samples)
+        values.push_back(s.*field);
+    return summarize(values).median;
+}
+
+// Medians over fresh processes. "first doc" runs from spawn to the first
+// parse returning; one-time is the first parse (including constructing
+// the adapter) minus a second parse of the same document.
+static int printStartupTable(const char *self, const std::vector<const AdapterInfo *> &selected,
+                             const std::vector<Corpus> &corpora, const RunOptions &options) {
+    int failures = 0;
+    printf("%-26s %-10s %10s %13s %13s %13s %13s %8s %8s\n", "corpus", "library", "bytes", "first doc us",
+           "1st parse us", "2nd parse us", "one-time us", "faults", "parse");
+    for (const Corpus &corpus : corpora) {
+        for (const AdapterInfo *info : selected) {
+            StartupResult r = runStartup(self, *info, corpus, options.warmup, options.iterations);
+            if (!r.ok) {
+                printf("%-26s %-10s %10zu %13s\n", r.corpus.c_str(), r.library.c_str(), r.bytes, "FAILED");
+                ++failures;
+                continue;
+            }
+            double first = medianOf(r.samples, &StartupSample::firstParseNs);
+            double second = medianOf(r.samples, &StartupSample::secondParseNs);
+            printf("%-26s %-10s %10zu %13.1f %13.1f %13.1f %13.1f %8.0f %8.0f\n", r.corpus.c_str(),
+                   r.library.c_str(), r.bytes, medianOf(r.samples, &StartupSample::firstDocumentNs) / 1e3,
+                   first / 1e3, second / 1e3, (first - second) / 1e3, medianOf(r.samples, &StartupSample::faults),
+                   medianOf(r.samples, &StartupSample::parseFaults));
+        }
+    }
+    return failures;
+}
+
+// Aggregate throughput of 1..maxThreads concurrent parsers. Efficiency is
+// throughput per thread relative to the single-thread run; imbalance is the
+// slowest thread's time over the fastest's.
+static int runScalingTables(const std::vector<const AdapterInfo *> &selected, const std::vector<Corpus> &corpora,
+                            const std::vector<Workload> &workloads, RunOptions options, int maxThreads) {
+    int failures = 0;
+    printf("%-26s %-10s %-6s %7s %12s %10s %8s %10s %9s\n",
+           "corpus", "library", "work", "threads", "docs/s", "MB/s", "speedup", "efficiency", "imbalance");
+    for (const Corpus &corpus : corpora) {
+        for (Workload workload : workloads) {
+            options.workload = workload;
+            for (const AdapterInfo *info : selected) {
+                double single = 0;
+                for (int threads : threadCounts(maxThreads)) {
+                    ScalingResult r = runScaling(*info, corpus, options, threads);
+                    if (!r.ok) {
+                        printf("%-26s %-10s %-6s %7d %12s\n", r.corpus.c_str(), r.library.c_str(),
+                               workloadName(workload), threads, r.supported ? "FAILED" : "n/a");
+                        failures += r.supported;
+                        break;
+                    }
+                    if (threads == 1)
+                        single = r.mbPerSec();
+                    double speedup = single > 0 ? r.mbPerSec() / single : 0;
+                    uint64_t slowest = *std::max_element(r.threadNs.begin(), r.threadNs.end());
+                    uint64_t fastest = *std::min_element(r.threadNs.begin(), r.threadNs.end());
+                    printf("%-26s %-10s %-6s %7d %12.0f %10.1f %7.2fx %9.0f%% %9.2f\n",
+                           r.corpus.c_str(), r.library.c_str(), workloadName(workload), threads,
+                           r.documentsPerSec(), r.mbPerSec(), speedup, 100 * speedup / threads,
+                           fastest ? double(slowest) / fastest : 0);
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+static bool parseCount(const char *arg, int &value) {
+    char *end;
+    long n = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || n < 0 || n > 1000000000)
+        return false;
+    value = (int)n;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && !strcmp(argv[1], "--first-parse"))
+        return firstParseMain(argv[2], argv[3]);
+
+    RunOptions options;
+    std::vector<Workload> workloads;
+    std::vector<CacheMode> cacheModes;
+    std::vector<std::string> libraries;
+    std::vector<std::string> paths;
+    bool perf = false;
+    bool assertSteady = false;
+    const char *savePath = nullptr;
+    const char *baselinePath = nullptr;
+    const char *reportPath = nullptr;
+    double threshold = 0.02;
+    int maxThreads = -1;
+    bool footprint = false;
+    bool serialize = false;
+    bool query = false;
+    bool startup = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+            usage(argv[0]);
+            return 0;
+        } else if (!strcmp(arg, "--perf")) {
+            perf = true;
+        } else if (!strcmp(arg, "--allocs")) {
+            options.trackAllocs = true;
+        } else if (!strcmp(arg, "--reuse")) {
+            options.reuse = true;
+        } else if (!strcmp(arg, "--assert-steady")) {
+            assertSteady = options.trackAllocs = options.reuse = true;
+        } else if (!strcmp(arg, "--serialize")) {
+            serialize = options.trackAllocs = true;
+            workloads = {WORKLOAD_DUMP, WORKLOAD_PRETTY};
+        } else if (!strcmp(arg, "--startup")) {
+            startup = true;
+        } else if (!strcmp(arg, "--query")) {
+            query = true;
+        } else if (!strcmp(arg, "--footprint")) {
+            footprint = true;
+        } else if (!strcmp(arg, "--save") && hasValue) {
+            savePath = argv[++i];
+        } else if (!strcmp(arg, "--report") && hasValue) {
+            reportPath = argv[++i];
+        } else if (!strcmp(arg, "--baseline") && hasValue) {
+            baselinePath = argv[++i];
+        } else if (!strcmp(arg, "--threshold") && hasValue) {
+            char *end;
+            threshold = strtod(argv[++i], &end) / 100;
+            if (*end != '\0' || end == argv[i] || threshold < 0) {
+                fprintf(stderr, "bad threshold: %s\n", argv[i]);
+                return 2;
+            }
+        } else if ((!strcmp(arg, "-j") || !strcmp(arg, "--threads")) && hasValue) {
+            if (!parseCount(argv[++i], maxThreads) || maxThreads > 4096) {
+                fprintf(stderr, "bad thread count: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (!strcmp(arg, "--list")) {
+            for (const AdapterInfo &info : adapterRegistry())
+                printf("%s\n", info.name);
+            return 0;
+        } else if ((!strcmp(arg, "-l") || !strcmp(arg, "--library")) && hasValue) {
+            libraries.push_back(argv[++i]);
+        } else if ((!strcmp(arg, "-n") || !strcmp(arg, "--iterations")) && hasValue) {
+            if (!parseCount(argv[++i], options.iterations) || options.iterations == 0) {
+                fprintf(stderr, "bad iteration count: %s\n", argv[i]);
+                return 2;
+            }
+        } else if ((!strcmp(arg, "-w") || !strcmp(arg, "--warmup")) && hasValue) {
+            if (!parseCount(argv[++i], options.warmup)) {
+                fprintf(stderr, "bad warmup count: %s\n", argv[i]);
+                return 2;
+            }
+        } else if ((!strcmp(arg, "-c") || !strcmp(arg, "--cache")) && hasValue) {
+            CacheMode mode;
+            if (!strcmp(argv[++i], "all")) {
+                cacheModes = {CACHE_HOT, CACHE_EVICT, CACHE_MMAP, CACHE_FRESH};
+            } else if (cacheModeFromName(argv[i], mode)) {
+                cacheModes.push_back(mode);
+            } else {
+                fprintf(stderr, "unknown cache mode: %s\n", argv[i]);
+                return 2;
+            }
+        } else if ((!strcmp(arg, "-W") || !strcmp(arg, "--workload")) && hasValue) {
+            Workload workload;
+            if (!strcmp(argv[++i], "all")) {
+                workloads = {WORKLOAD_PARSE, WORKLOAD_WALK, WORKLOAD_DUMP, WORKLOAD_PRETTY};
+            } else if (workloadFromName(argv[i], workload)) {
+                workloads.push_back(workload);
+            } else {
+                fprintf(stderr, "unknown workload: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (arg[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    std::vector<const AdapterInfo *> selected;
+    for (const AdapterInfo &info : adapterRegistry()) {
+        bool wanted = libraries.empty();
+        for (const std::string &name : libraries)
+            wanted = wanted || name == info.name;
+        if (wanted)
+            selected.push_back(&info);
+    }
+    for (const std::string &name : libraries) {
+        bool known = false;
+        for (const AdapterInfo &info : adapterRegistry())
+            known = known || name == info.name;
+        if (!known) {
+            fprintf(stderr, "unknown library: %s\n", name.c_str());
+            return 2;
+        }
+    }
+
+    if (workloads.empty())
+        workloads.push_back(WORKLOAD_PARSE);
+    if (cacheModes.empty())
+        cacheModes.push_back(CACHE_HOT);
+    if (paths.empty())
+        paths = defaultCorpusPaths(JSONBENCH_CORPUS_DIR);
+
+    std::vector<Corpus> corpora;
+    for (const std::string &path : paths) {
+        Corpus corpus;
+        bool bareName = path.find('/') == std::string::npos;
+        if (!loadCorpus(path, corpus) && !(bareName && loadCorpus(JSONBENCH_CORPUS_DIR "/" + path, corpus))) {
+            fprintf(stderr, "cannot read %s\n", path.c_str());
+            return 1;
+        }
+        corpora.push_back(std::move(corpus));
+    }
+
+    if (query)
+        return printQueryTable(selected, options) ? 1 : 0;
+    if (startup) {
+        const char *self = access("/proc/self/exe", X_OK) == 0 ? "/proc/self/exe" : argv[0];
+        return printStartupTable(self, selected, corpora, options) ? 1 : 0;
+    }
+
+    if (footprint) {
+        if (!allocTrackingAvailable()) {
+            fprintf(stderr, "--footprint needs glibc\n");
+            return 2;
+        }
+        return printFootprintTable(selected, corpora) ? 1 : 0;
+    }
+
+    if (maxThreads >= 0) {
+        if (perf || options.trackAllocs || savePath || baselinePath || reportPath) {
+            fprintf(stderr, "--threads cannot be combined with --perf, --allocs, --save, --baseline or --report\n");
+            return 2;
+        }
+        if (maxThreads == 0)
+            maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        return runScalingTables(selected, corpora, workloads, options, maxThreads) ? 1 : 0;
+    }
+
+    if (options.trackAllocs && !allocTrackingAvailable()) {
+        fprintf(stderr, "allocation tracking needs glibc\n");
+        return 2;
+    }
+
+    std::vector<RunResult> baseline;
+    if (baselinePath) {
+        std::string error;
+        if (!loadResults(baselinePath, baseline, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    PerfCounters counters;
+    if (perf) {
+        std::string error;
+        if (counters.open(error))
+            options.counters = &counters;
+        else
+            fprintf(stderr, "hardware counters unavailable: %s\n", error.c_str());
+    }
+
+    // Times are median ns per document; "walk/dump" is the second phase only.
+    // ci is the half-width of the 95% bootstrap interval of the median total.
+    int failures = 0;
+    std::vector<RunResult> results;
+    printf("%-26s %-10s %-12s %10s %12s %12s %12s %7s %12s %12s %10s\n",
+           "corpus", "library", "work", "bytes", "parse ns", "walk/dump ns", "total ns", "ci", "p90 ns", "p99 ns", "MB/s");
+    for (const Corpus &corpus : corpora) {
+        for (Workload workload : workloads) {
+            options.workload = workload;
+            uint64_t checksum = 0;
+            const char *checksumOwner = nullptr;
+            for (CacheMode cache : cacheModes) {
+                options.cache = cache;
+                for (const AdapterInfo *info : selected) {
+                    std::unique_ptr<Adapter> adapter = info->create();
+                    RunResult r = runBenchmark(*adapter, corpus, options);
+                    printResult(r);
+                    results.push_back(r);
+                    if (!r.ok) {
+                        failures += r.supported;
+                        continue;
+                    }
+                    if (workload != WORKLOAD_WALK)
+                        continue;
+                    if (!checksumOwner) {
+                        checksum = r.checksum;
+                        checksumOwner = info->name;
+                    } else if (r.checksum != checksum) {
+                        fprintf(stderr, "%s: %s walk checksum %llu differs from %s (%llu)\n",
+                                corpus.name.c_str(), info->name, (unsigned long long)r.checksum,
+                                checksumOwner, (unsigned long long)checksum);
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+    if (options.counters)
+        printPerfTable(results);
+    if (serialize)
+        printSerializeTable(results);
+    else if (options.trackAllocs)
+        printAllocTable(results);
+    if (cacheModes.size() > 1 || cacheModes[0] != CACHE_HOT)
+        printCacheTable(results);
+    if (assertSteady)
+        failures += checkSteadyState(results);
+    if (baselinePath)
+        failures += printComparison(results, baseline, threshold);
+    if (savePath) {
+        std::string error;
+        if (!saveResults(savePath, results, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            ++failures;
+        }
+    }
+    if (reportPath) {
+        std::string error;
+        if (!writeReport(reportPath, results, baseline, threshold, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            ++failures;
+        }
+    }
+    return failures ? 1 : 0;
+}
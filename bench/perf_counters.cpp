@@ -0,0 +1,147 @@
+#include "perf_counters.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *const kEventNames[PERF_EVENTS] = {
+    "cycles",
+    "instructions",
+    "branch-misses",
+    "L1d-misses",
+    "LLC-misses",
+    "dTLB-misses",
+};
+
+const char *perfEventName(int event) {
+    return kEventNames[event];
+}
+
+bool PerfReading::any() const {
+    for (bool v : valid)
+        if (v)
+            return true;
+    return false;
+}
+
+double PerfReading::ratio(int num, int den) const {
+    if (!valid[num] || !valid[den] || count[den] == 0)
+        return -1;
+    return (double)count[num] / count[den];
+}
+
+PerfCounters::PerfCounters() {
+    for (int &fd : fds)
+        fd = -1;
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds)
+        if (fd != -1)
+            close(fd);
+#endif
+}
+
+#ifdef __linux__
+
+static uint64_t cacheMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+bool PerfCounters::open(std::string &error) {
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } kEvents[PERF_EVENTS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_LL)},
+        {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_DTLB)},
+    };
+
+    int lastErrno = 0;
+    bool opened = false;
+    for (int i = 0; i < PERF_EVENTS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = kEvents[i].type;
+        attr.config = kEvents[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds[i] == -1)
+            lastErrno = errno;
+        else
+            opened = true;
+    }
+    if (!opened)
+        error = strerror(lastErrno);
+    return opened;
+}
+
+void PerfCounters::reset() {
+    for (int fd : fds)
+        if (fd != -1)
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+}
+
+void PerfCounters::start() {
+    for (int fd : fds)
+        if (fd != -1)
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void PerfCounters::stop() {
+    for (int fd : fds)
+        if (fd != -1)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+PerfReading PerfCounters::read() const {
+    PerfReading reading;
+    for (int i = 0; i < PERF_EVENTS; ++i) {
+        uint64_t buf[3]; // value, time enabled, time running
+        if (fds[i] == -1 || ::read(fds[i], buf, sizeof(buf)) != (ssize_t)sizeof(buf))
+            continue;
+        if (buf[2] == 0)
+            continue;
+        reading.count[i] = buf[2] < buf[1] ? (uint64_t)((double)buf[0] * buf[1] / buf[2]) : buf[0];
+        reading.valid[i] = true;
+    }
+    return reading;
+}
+
+#else
+
+bool PerfCounters::open(std::string &error) {
+    error = "perf_event_open is only available on Linux";
+    return false;
+}
+
+void PerfCounters::reset() {
+}
+
+void PerfCounters::start() {
+}
+
+void PerfCounters::stop() {
+}
+
+PerfReading PerfCounters::read() const {
+    return PerfReading();
+}
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_EVENTS
+};
+
+const char *perfEventName(int event);
+
+struct PerfReading {
+    uint64_t count[PERF_EVENTS] = {};
+    bool valid[PERF_EVENTS] = {};
+
+    bool any() const;
+    // count[num] / count[den], or a negative value if either is missing.
+    double ratio(int num, int den) const;
+};
+
+// User-space hardware counters of the calling thread, opened one by one
+// with perf_event_open(2) so a PMU short of slots multiplexes them instead
+// of refusing the whole set; readings are scaled by enabled/running time.
+// Events the kernel refuses stay invalid.
+class PerfCounters {
+    int fds[PERF_EVENTS];
+
+public:
+    PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+    ~PerfCounters();
+
+    // Returns false with a reason when no event could be opened.
+    bool open(std::string &error);
+    void reset();
+    void start();
+    void stop();
+    PerfReading read() const;
+};
@@ -0,0 +1,143 @@
+#include "query.h"
+#include "random.h"
+#include "runner.h"
+#include "stats.h"
+
+#include "rapidjson/document.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+static const char *const kPatternNames[] = {"point", "path", "missing", "iterate"};
+
+// Short passes are repeated until a sample covers this many lookups, so
+// that clock overhead stays negligible.
+static const size_t kMinAccesses = 4096;
+
+static const uint64_t kSeed = 0x9E3779B9;
+
+const char *queryPatternName(QueryPattern pattern) {
+    return kPatternNames[pattern];
+}
+
+static std::string fieldName(int i) {
+    char name[16];
+    snprintf(name, sizeof(name), "field%04d", i);
+    return name;
+}
+
+Corpus wideDocument(int width) {
+    Corpus corpus;
+    char name[32];
+    snprintf(name, sizeof(name), "wide-%d", width);
+    corpus.name = name;
+    corpus.data = "{";
+    for (int i = 0; i < width; ++i) {
+        char member[128];
+        snprintf(member, sizeof(member), "%s\"%s\":{\"id\":%d,\"name\":\"item %d\",\"child\":{\"value\":\"v%d\"}}",
+                 i ? "," : "", fieldName(i).c_str(), i, i, i);
+        corpus.data += member;
+    }
+    corpus.data += "}";
+    return corpus;
+}
+
+void wideQueries(int width, QueryPattern pattern, QuerySet &set) {
+    set.pattern = pattern;
+    set.keys.clear();
+    set.paths.clear();
+    if (pattern == QUERY_ITERATE) {
+        set.paths.push_back(std::vector<PathStep>());
+        set.accesses = width;
+        return;
+    }
+
+    // Keys in a fixed random order, so that list position does not
+    // favour early members. Missing keys share the prefix of real ones.
+    std::vector<int> order(width);
+    for (int i = 0; i < width; ++i)
+        order[i] = i;
+    Random rng(kSeed);
+    for (int i = width - 1; i > 0; --i)
+        std::swap(order[i], order[rng.below(i + 1)]);
+    for (int i : order)
+        set.keys.push_back(fieldName(i) + (pattern == QUERY_MISSING ? "x" : ""));
+    set.keys.push_back("child");
+    set.keys.push_back("value");
+
+    const std::string &child = set.keys[width];
+    const std::string &value = set.keys[width + 1];
+    for (int i = 0; i < width; ++i) {
+        std::vector<PathStep> path = {{set.keys[i].c_str(), 0}};
+        if (pattern == QUERY_PATH) {
+            path.push_back({child.c_str(), 0});
+            path.push_back({value.c_str(), 0});
+        }
+        set.paths.push_back(path);
+    }
+    set.accesses = width;
+}
+
+bool trackQueries(const Corpus &corpus, QueryPattern pattern, QuerySet &set) {
+    rapidjson::Document doc;
+    doc.Parse(corpus.data.c_str());
+    if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("message") || !doc["message"].IsObject() ||
+        !doc["message"].HasMember("body") || !doc["message"]["body"].IsObject() ||
+        !doc["message"]["body"].HasMember("track_list") || !doc["message"]["body"]["track_list"].IsArray())
+        return false;
+    size_t tracks = doc["message"]["body"]["track_list"].Size();
+
+    set.pattern = pattern;
+    set.keys = {"message", "body", "track_list", "track", pattern == QUERY_MISSING ? "lyrics_url" : "track_name"};
+    set.paths.clear();
+    for (size_t i = 0; i < tracks; ++i) {
+        set.paths.push_back({{set.keys[0].c_str(), 0},
+                             {set.keys[1].c_str(), 0},
+                             {set.keys[2].c_str(), 0},
+                             {nullptr, i},
+                             {set.keys[3].c_str(), 0},
+                             {set.keys[4].c_str(), 0}});
+    }
+    set.accesses = tracks;
+    return tracks > 0;
+}
+
+double QueryResult::nsPerAccess() const {
+    return accesses ? summarize(ns).median / accesses : 0;
+}
+
+QueryResult runQuery(Adapter &adapter, const Corpus &document, const QuerySet &set, int warmup, int iterations) {
+    QueryResult result;
+    result.library = adapter.name();
+
+    std::vector<char> buffer(document.data.begin(), document.data.end());
+    buffer.push_back('\0');
+    if (!adapter.parse(buffer.data(), document.data.size()) || !set.accesses) {
+        adapter.clear();
+        return result;
+    }
+
+    size_t passes = (kMinAccesses + set.accesses - 1) / set.accesses;
+    result.accesses = passes * set.accesses;
+    result.ns.reserve(iterations);
+    bool ok = true;
+    for (int i = 0; i < warmup + iterations && ok; ++i) {
+        size_t misses = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t p = 0; p < passes; ++p) {
+            for (const std::vector<PathStep> &path : set.paths) {
+                uint64_t found = set.pattern == QUERY_ITERATE ? adapter.iterate(path.data(), path.size())
+                                                              : adapter.find(path.data(), path.size());
+                misses += found == 0;
+            }
+        }
+        Clock::time_point stop = Clock::now();
+        ok = misses == (set.pattern == QUERY_MISSING ? passes * set.paths.size() : 0);
+        if (i >= warmup)
+            result.ns.push_back(elapsedNs(start, stop));
+    }
+    adapter.clear();
+    result.ok = ok;
+    return result;
+}
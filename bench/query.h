@@ -0,0 +1,52 @@
+#pragma once
+
+#include "adapters.h"
+#include "corpus.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum QueryPattern {
+    QUERY_POINT,   // one key of a wide object
+    QUERY_PATH,    // a key a few levels below a wide object
+    QUERY_MISSING, // a key that is not there
+    QUERY_ITERATE, // every member of a wide object
+    QUERY_PATTERNS
+};
+
+const char *queryPatternName(QueryPattern pattern);
+
+// Lookups to replay against one document. Paths point into keys, so a set
+// must not be copied after it is built.
+struct QuerySet {
+    QueryPattern pattern = QUERY_POINT;
+    std::vector<std::string> keys;
+    std::vector<std::vector<PathStep>> paths;
+    // How many lookups a pass over paths makes: one per path, or one per
+    // member visited for QUERY_ITERATE.
+    size_t accesses = 0;
+};
+
+// An object of width members named field0000.., each holding a small
+// object with a nested child.
+Corpus wideDocument(int width);
+void wideQueries(int width, QueryPattern pattern, QuerySet &set);
+
+// message.body.track_list[i].track.track_name for every track of
+// track.chart.get.json; QUERY_MISSING asks for an absent field instead.
+// Returns false if the corpus does not have that shape.
+bool trackQueries(const Corpus &corpus, QueryPattern pattern, QuerySet &set);
+
+struct QueryResult {
+    std::string library;
+    bool ok = false;
+    size_t accesses = 0;         // per sample
+    std::vector<uint64_t> ns;    // one entry per sample
+
+    double nsPerAccess() const;  // at the median sample
+};
+
+// Parses document once and replays set warmup + iterations times. Fails if
+// a lookup that should hit misses or the other way round.
+QueryResult runQuery(Adapter &adapter, const Corpus &document, const QuerySet &set, int warmup, int iterations);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// splitmix64: tiny, fast and identical everywhere, unlike the
+// distributions of <random>.
+class Random {
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed)
+        : state(seed) {
+    }
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    uint64_t below(uint64_t n) {
+        return next() % n;
+    }
+    int64_t range(int64_t lo, int64_t hi) {
+        return lo + (int64_t)below((uint64_t)(hi - lo + 1));
+    }
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+    bool chance(double p) {
+        return p > 0 && uniform() < p;
+    }
+    template <size_t N>
+    const char *pick(const char *const (&words)[N]) {
+        return words[below(N)];
+    }
+};
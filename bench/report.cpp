@@ -0,0 +1,354 @@
+#include "report.h"
+#include "baseline.h"
+#include "stats.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace {
+
+static const char *const kColors[] = {"#1f77b4", "#d62728", "#2ca02c", "#9467bd", "#ff7f0e", "#8c564b", "#e377c2"};
+
+// Sub-buckets per power of two, as in HdrHistogram with ~9% bucket width.
+static const int kBucketsPerOctave = 8;
+
+static std::string format(const char *fmt, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+}
+
+static std::string escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        switch (c) {
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '"': out += "&quot;"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+static std::string formatNs(double ns) {
+    if (ns >= 1e9)
+        return format("%.3g s", ns / 1e9);
+    if (ns >= 1e6)
+        return format("%.3g ms", ns / 1e6);
+    if (ns >= 1e3)
+        return format("%.3g &#181;s", ns / 1e3);
+    return format("%.3g ns", ns);
+}
+
+static std::string formatBytes(double bytes) {
+    if (bytes >= 1e9)
+        return format("%.3g GB", bytes / 1e9);
+    if (bytes >= 1e6)
+        return format("%.3g MB", bytes / 1e6);
+    if (bytes >= 1e3)
+        return format("%.3g kB", bytes / 1e3);
+    return format("%.0f B", bytes);
+}
+
+struct Point {
+    double x, y;
+};
+
+struct Series {
+    std::string label;
+    const char *color;
+    bool dashed;
+    bool markers;
+    std::vector<Point> points;
+};
+
+// A line chart with a logarithmic x axis and a linear y axis starting at 0.
+class Chart {
+public:
+    Chart(const std::string &title, const std::string &xLabel, const std::string &yLabel,
+          std::string (*xFormat)(double))
+        : title(title), xLabel(xLabel), yLabel(yLabel), xFormat(xFormat) {}
+
+    void add(const Series &series) {
+        if (!series.points.empty())
+            series_.push_back(series);
+    }
+
+    std::string svg() const {
+        double xMin = INFINITY, xMax = 0, yMax = 0;
+        for (const Series &s : series_) {
+            for (const Point &p : s.points) {
+                xMin = std::min(xMin, p.x);
+                xMax = std::max(xMax, p.x);
+                yMax = std::max(yMax, p.y);
+            }
+        }
+        if (series_.empty() || xMin <= 0)
+            return "";
+        // Widen very narrow ranges so that at least one tick is visible.
+        double lo = log10(xMin), hi = log10(xMax);
+        if (hi - lo < 0.3) {
+            lo -= 0.15;
+            hi += 0.15;
+        }
+        yMax = yMax > 0 ? niceCeil(yMax * 1.05) : 1;
+
+        std::string out = format("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" "
+                                 "viewBox=\"0 0 %d %d\">\n", kWidth, kHeight, kWidth, kHeight);
+        out += format("<text x=\"%d\" y=\"18\" class=\"title\">%s</text>\n", kLeft, escape(title).c_str());
+
+        // y grid
+        for (int i = 0; i <= 4; ++i) {
+            double y = mapY(yMax * i / 4, yMax);
+            out += format("<line x1=\"%d\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" class=\"grid\"/>\n",
+                          kLeft, y, kWidth - kRight, y);
+            out += format("<text x=\"%d\" y=\"%.1f\" class=\"ytick\">%.4g</text>\n", kLeft - 6, y + 4,
+                          yMax * i / 4);
+        }
+        // x grid at 1, 2 and 5 times powers of ten
+        for (int decade = (int)floor(lo); decade <= (int)ceil(hi); ++decade) {
+            for (int m : {1, 2, 5}) {
+                double v = m * pow(10.0, decade);
+                double lv = log10(v);
+                if (lv < lo || lv > hi)
+                    continue;
+                double x = mapX(lv, lo, hi);
+                out += format("<line x1=\"%.1f\" y1=\"%d\" x2=\"%.1f\" y2=\"%d\" class=\"grid\"/>\n",
+                              x, kTop, x, kHeight - kBottom);
+                out += format("<text x=\"%.1f\" y=\"%d\" class=\"xtick\">%s</text>\n", x, kHeight - kBottom + 16,
+                              xFormat(v).c_str());
+            }
+        }
+        out += format("<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" class=\"frame\"/>\n",
+                      kLeft, kTop, kWidth - kLeft - kRight, kHeight - kTop - kBottom);
+        out += format("<text x=\"%d\" y=\"%d\" class=\"xlabel\">%s</text>\n", (kLeft + kWidth - kRight) / 2,
+                      kHeight - 8, escape(xLabel).c_str());
+        out += format("<text x=\"14\" y=\"%d\" class=\"ylabel\" transform=\"rotate(-90 14 %d)\">%s</text>\n",
+                      (kTop + kHeight - kBottom) / 2, (kTop + kHeight - kBottom) / 2, escape(yLabel).c_str());
+
+        for (size_t i = 0; i < series_.size(); ++i) {
+            const Series &s = series_[i];
+            out += format("<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"1.5\"%s points=\"", s.color,
+                          s.dashed ? " stroke-dasharray=\"5,3\"" : "");
+            for (const Point &p : s.points)
+                out += format("%.1f,%.1f ", mapX(log10(p.x), lo, hi), mapY(p.y, yMax));
+            out += "\"/>\n";
+            if (s.markers) {
+                for (const Point &p : s.points)
+                    out += format("<circle cx=\"%.1f\" cy=\"%.1f\" r=\"2.5\" fill=\"%s\"/>\n",
+                                  mapX(log10(p.x), lo, hi), mapY(p.y, yMax), s.color);
+            }
+            int ly = kTop + 14 + 16 * (int)i;
+            int lx = kWidth - kRight + 10;
+            out += format("<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"%s\" stroke-width=\"2\"%s/>\n",
+                          lx, ly - 4, lx + 18, ly - 4, s.color, s.dashed ? " stroke-dasharray=\"5,3\"" : "");
+            out += format("<text x=\"%d\" y=\"%d\" class=\"legend\">%s</text>\n", lx + 24, ly,
+                          escape(s.label).c_str());
+        }
+        out += "</svg>\n";
+        return out;
+    }
+
+private:
+    static const int kWidth = 760, kHeight = 300;
+    static const int kLeft = 60, kRight = 170, kTop = 28, kBottom = 42;
+
+    static double niceCeil(double v) {
+        double step = pow(10.0, floor(log10(v)));
+        for (double m : {1.0, 2.0, 2.5, 5.0, 10.0}) {
+            if (m * step >= v)
+                return m * step;
+        }
+        return 10 * step;
+    }
+
+    static double mapX(double logValue, double lo, double hi) {
+        return kLeft + (logValue - lo) / (hi - lo) * (kWidth - kLeft - kRight);
+    }
+
+    static double mapY(double v, double yMax) {
+        return kHeight - kBottom - v / yMax * (kHeight - kTop - kBottom);
+    }
+
+    std::string title, xLabel, yLabel;
+    std::string (*xFormat)(double);
+    std::vector<Series> series_;
+};
+
+// Fraction of samples per logarithmic bucket, plotted at bucket centres.
+static std::vector<Point> histogram(const std::vector<uint64_t> &samples) {
+    std::vector<int> counts;
+    int first = -1;
+    for (uint64_t ns : samples) {
+        int bucket = (int)floor(log2((double)std::max<uint64_t>(ns, 1)) * kBucketsPerOctave);
+        if (first < 0 || bucket < first) {
+            if (first >= 0)
+                counts.insert(counts.begin(), first - bucket, 0);
+            first = bucket;
+        }
+        if ((size_t)(bucket - first) >= counts.size())
+            counts.resize(bucket - first + 1);
+        ++counts[bucket - first];
+    }
+    std::vector<Point> points;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        double centre = exp2((first + i + 0.5) / kBucketsPerOctave);
+        points.push_back({centre, 100.0 * counts[i] / samples.size()});
+    }
+    return points;
+}
+
+static std::vector<Point> cdf(const std::vector<uint64_t> &samples) {
+    std::vector<uint64_t> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<Point> points;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        double x = (double)std::max<uint64_t>(sorted[i], 1);
+        points.push_back({x, 100.0 * i / sorted.size()});
+        points.push_back({x, 100.0 * (i + 1) / sorted.size()});
+    }
+    return points;
+}
+
+static const char *colorOf(const std::vector<std::string> &libraries, const std::string &library) {
+    size_t i = std::find(libraries.begin(), libraries.end(), library) - libraries.begin();
+    return kColors[i % (sizeof(kColors) / sizeof(kColors[0]))];
+}
+
+static const char *verdictName(Verdict v) {
+    return v == VERDICT_SLOWER ? "slower" : v == VERDICT_FASTER ? "faster" : "same";
+}
+
+static const char kStyle[] =
+    "body{font:14px -apple-system,Helvetica,Arial,sans-serif;margin:24px;color:#222}"
+    "h2{margin-top:32px;border-bottom:1px solid #ccc}"
+    "table{border-collapse:collapse;margin:8px 0}"
+    "td,th{padding:3px 10px;text-align:right;border-bottom:1px solid #eee}"
+    "td:first-child,th:first-child,td:nth-child(2),th:nth-child(2){text-align:left}"
+    ".slower{color:#c00;font-weight:bold}.faster{color:#080}"
+    "svg{display:block;margin:6px 0}"
+    "svg text{font-size:11px;fill:#333}"
+    "svg .title{font-size:13px;font-weight:bold}"
+    "svg .xtick,svg .xlabel{text-anchor:middle}svg .ytick{text-anchor:end}svg .ylabel{text-anchor:middle}"
+    "svg .grid{stroke:#e4e4e4}svg .frame{fill:none;stroke:#999}";
+
+} // namespace
+
+bool writeReport(const std::string &path, const std::vector<RunResult> &results,
+                 const std::vector<RunResult> &baseline, double threshold, std::string &error) {
+    std::vector<std::string> libraries, corpora;
+    std::vector<std::string> workloads;
+    for (const RunResult &r : results) {
+        if (!r.ok)
+            continue;
+        if (std::find(libraries.begin(), libraries.end(), r.library) == libraries.end())
+            libraries.push_back(r.library);
+        if (std::find(corpora.begin(), corpora.end(), r.corpus) == corpora.end())
+            corpora.push_back(r.corpus);
+        if (std::find(workloads.begin(), workloads.end(), r.label()) == workloads.end())
+            workloads.push_back(r.label());
+    }
+
+    std::string html = "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n"
+                       "<title>JSON parser benchmark</title>\n<style>";
+    html += kStyle;
+    html += "</style>\n</head>\n<body>\n<h1>JSON parser benchmark</h1>\n";
+    html += "<p>Latency is parse plus walk/dump time per document. Histograms use logarithmic buckets "
+            "(8 per power of two) and show the share of iterations per bucket.";
+    if (!baseline.empty())
+        html += " Dashed lines are the baseline.";
+    html += "</p>\n";
+
+    // Summary and comparison table.
+    html += "<table>\n<tr><th>corpus</th><th>library</th><th>work</th><th>median</th><th>p90</th>"
+            "<th>p99</th><th>MB/s</th>";
+    if (!baseline.empty())
+        html += "<th>baseline median</th><th>median ratio [95% CI]</th><th>p90 ratio [95% CI]</th>";
+    html += "</tr>\n";
+    for (const RunResult &r : results) {
+        if (!r.ok)
+            continue;
+        Summary s = summarize(r.totalNs());
+        html += format("<tr><td>%s</td><td>%s</td><td>%s</td><td>%s</td><td>%s</td><td>%s</td><td>%.1f</td>",
+                       escape(r.corpus).c_str(), escape(r.library).c_str(), r.label().c_str(),
+                       formatNs(s.median).c_str(), formatNs(s.p90).c_str(), formatNs(s.p99).c_str(),
+                       r.mbPerSec());
+        const RunResult *base = baseline.empty() ? nullptr : findResult(baseline, r);
+        if (base) {
+            std::vector<uint64_t> before = base->totalNs(), after = r.totalNs();
+            html += format("<td>%s</td>", formatNs(summarize(before).median).c_str());
+            for (double p : {50.0, 90.0}) {
+                Comparison c = comparePercentile(before, after, p, threshold);
+                html += format("<td class=\"%s\">%.3f [%.3f, %.3f] %s</td>", verdictName(c.verdict), c.ratio,
+                               c.low, c.high, verdictName(c.verdict));
+            }
+        } else if (!baseline.empty()) {
+            html += "<td></td><td></td><td></td>";
+        }
+        html += "</tr>\n";
+    }
+    html += "</table>\n";
+
+    // Throughput against document size, one line per library and workload.
+    if (corpora.size() > 1) {
+        html += "<h2>Throughput by document size</h2>\n";
+        Chart chart("Median throughput", "document size", "MB/s", formatBytes);
+        for (const std::string &workload : workloads) {
+            for (const std::string &library : libraries) {
+                Series s{library + (workloads.size() > 1 ? " " + workload : ""),
+                         colorOf(libraries, library), workload != workloads.front(), true, {}};
+                for (const RunResult &r : results) {
+                    if (r.ok && r.library == library && r.label() == workload)
+                        s.points.push_back({(double)r.bytes, r.mbPerSec()});
+                }
+                std::sort(s.points.begin(), s.points.end(),
+                          [](const Point &a, const Point &b) { return a.x < b.x; });
+                chart.add(s);
+            }
+        }
+        html += chart.svg();
+    }
+
+    for (const std::string &corpus : corpora) {
+        for (const std::string &workload : workloads) {
+            std::string name = corpus + " / " + workload;
+            Chart hist("Latency histogram: " + name, "ns per document", "% of iterations", formatNs);
+            Chart dist("Latency CDF: " + name, "ns per document", "% of iterations at or below", formatNs);
+            for (const RunResult &r : results) {
+                if (!r.ok || r.corpus != corpus || r.label() != workload)
+                    continue;
+                const char *color = colorOf(libraries, r.library);
+                hist.add({r.library, color, false, false, histogram(r.totalNs())});
+                dist.add({r.library, color, false, false, cdf(r.totalNs())});
+                const RunResult *base = baseline.empty() ? nullptr : findResult(baseline, r);
+                if (base && base->ok) {
+                    hist.add({r.library + " (base)", color, true, false, histogram(base->totalNs())});
+                    dist.add({r.library + " (base)", color, true, false, cdf(base->totalNs())});
+                }
+            }
+            html += "<h2>" + escape(name) + "</h2>\n";
+            html += hist.svg();
+            html += dist.svg();
+        }
+    }
+    html += "</body>\n</html>\n";
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        error = "cannot create " + path;
+        return false;
+    }
+    fwrite(html.data(), 1, html.size(), fp);
+    if (fclose(fp) != 0) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "runner.h"
+
+#include <string>
+#include <vector>
+
+// Writes a self-contained HTML page with inline SVG charts: a latency
+// histogram and CDF per corpus and workload, throughput against document
+// size and, when baseline is not empty, the same distributions overlaid
+// with the baseline plus a table of significant changes.
+bool writeReport(const std::string &path, const std::vector<RunResult> &results,
+                 const std::vector<RunResult> &baseline, double threshold, std::string &error);
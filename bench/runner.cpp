@@ -0,0 +1,252 @@
+#include "runner.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+
+static const char *const kWorkloadNames[] = {"parse", "walk", "dump", "pretty"};
+static const char *const kCacheModeNames[] = {"hot", "evict", "mmap", "fresh"};
+
+const char *workloadName(Workload workload) {
+    return kWorkloadNames[workload];
+}
+
+bool workloadFromName(const char *name, Workload &workload) {
+    for (int i = 0; i <= WORKLOAD_PRETTY; ++i) {
+        if (!strcmp(name, kWorkloadNames[i])) {
+            workload = Workload(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *cacheModeName(CacheMode mode) {
+    return kCacheModeNames[mode];
+}
+
+bool cacheModeFromName(const char *name, CacheMode &mode) {
+    for (int i = 0; i <= CACHE_FRESH; ++i) {
+        if (!strcmp(name, kCacheModeNames[i])) {
+            mode = CacheMode(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string RunResult::label() const {
+    std::string s = workloadName(workload);
+    if (cache != CACHE_HOT)
+        s += std::string("/") + cacheModeName(cache);
+    return s;
+}
+
+std::vector<uint64_t> RunResult::totalNs() const {
+    std::vector<uint64_t> total(parseNs);
+    for (size_t i = 0; i < phaseNs.size() && i < total.size(); ++i)
+        total[i] += phaseNs[i];
+    return total;
+}
+
+double RunResult::mbPerSec() const {
+    std::vector<uint64_t> total = totalNs();
+    std::vector<double> sorted(total.begin(), total.end());
+    std::sort(sorted.begin(), sorted.end());
+    double ns = percentile(sorted, 50);
+    return ns > 0 ? bytes * 1e3 / ns : 0;
+}
+
+double RunResult::outputMbPerSec() const {
+    std::vector<double> sorted(phaseNs.begin(), phaseNs.end());
+    std::sort(sorted.begin(), sorted.end());
+    double ns = percentile(sorted, 50);
+    return ns > 0 ? outputBytes * 1e3 / ns : 0;
+}
+
+namespace {
+
+// Sweeping twice the last-level cache (at least 32 MB) with writes pushes
+// the document, the parser's state and most of the TLB out.
+static size_t evictionBytes() {
+    long llc = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    return std::max<size_t>(llc > 0 ? 2 * llc : 0, 32 << 20);
+}
+
+// Supplies the writable, NUL-terminated copy of the corpus that one
+// iteration parses.
+class Input {
+public:
+    Input(const Corpus &corpus, CacheMode mode) : corpus(corpus), mode(mode), fd(-1), data(nullptr) {
+        if (mode == CACHE_HOT || mode == CACHE_EVICT)
+            buffer.resize(corpus.data.size() + 1);
+        if (mode == CACHE_EVICT)
+            sweep.resize(evictionBytes());
+        if (mode == CACHE_MMAP)
+            fd = createFile();
+    }
+
+    ~Input() {
+        release();
+        if (fd >= 0)
+            close(fd);
+    }
+
+    // Returns nullptr if the input could not be prepared.
+    char *acquire() {
+        size_t size = corpus.data.size() + 1;
+        switch (mode) {
+        case CACHE_HOT:
+            memcpy(buffer.data(), corpus.data.c_str(), size);
+            return buffer.data();
+        case CACHE_EVICT:
+            memcpy(buffer.data(), corpus.data.c_str(), size);
+            for (size_t i = 0; i < sweep.size(); i += 64)
+                ++sweep[i];
+            return buffer.data();
+        case CACHE_MMAP: {
+            if (fd < 0)
+                return nullptr;
+            void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            data = p == MAP_FAILED ? nullptr : (char *)p;
+            return data;
+        }
+        case CACHE_FRESH:
+            data = (char *)malloc(size);
+            if (data)
+                memcpy(data, corpus.data.c_str(), size);
+            return data;
+        }
+        return nullptr;
+    }
+
+    void release() {
+        if (data && mode == CACHE_MMAP)
+            munmap(data, corpus.data.size() + 1);
+        else if (mode == CACHE_FRESH)
+            free(data);
+        data = nullptr;
+    }
+
+private:
+    // An unlinked temporary file holding the corpus and its terminating
+    // NUL. It stays in the page cache, so mapping it costs page faults but
+    // no disk reads.
+    int createFile() {
+        const char *dir = getenv("TMPDIR");
+        std::string path = std::string(dir && *dir ? dir : "/tmp") + "/jsonbench.XXXXXX";
+        int file = mkstemp(&path[0]);
+        if (file < 0)
+            return -1;
+        unlink(path.c_str());
+        size_t size = corpus.data.size() + 1;
+        if (write(file, corpus.data.c_str(), size) != (ssize_t)size) {
+            close(file);
+            return -1;
+        }
+        return file;
+    }
+
+    const Corpus &corpus;
+    CacheMode mode;
+    int fd;
+    char *data;
+    std::vector<char> buffer;
+    std::vector<char> sweep;
+};
+
+static uint64_t minorFaults() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+} // namespace
+
+RunResult runBenchmark(Adapter &adapter, const Corpus &corpus, const RunOptions &options) {
+    RunResult result;
+    result.library = adapter.name();
+    result.corpus = corpus.name;
+    result.workload = options.workload;
+    result.cache = options.cache;
+    result.bytes = corpus.data.size();
+    result.parseNs.reserve(options.iterations);
+    if (options.workload != WORKLOAD_PARSE)
+        result.phaseNs.reserve(options.iterations);
+
+    if (options.reuse)
+        result.reused = adapter.setReuse(true);
+    if (options.counters)
+        options.counters->reset();
+
+    Input input(corpus, options.cache);
+    for (int i = 0; i < options.warmup + options.iterations; ++i) {
+        bool timed = i >= options.warmup;
+        bool track = timed && options.trackAllocs;
+        char *json = input.acquire();
+        if (!json) {
+            fprintf(stderr, "cannot prepare %s input for %s\n", cacheModeName(options.cache), corpus.name.c_str());
+            return result;
+        }
+
+        uint64_t faults = timed ? minorFaults() : 0;
+        if (timed && options.counters)
+            options.counters->start();
+        if (track)
+            allocTrackingStart();
+        Clock::time_point start = Clock::now();
+        bool ok = adapter.parse(json, corpus.data.size());
+        Clock::time_point parsed = Clock::now();
+        if (track) {
+            result.parseAllocs += allocTrackingStop();
+            allocTrackingStart();
+        }
+
+        Clock::time_point phaseStart = Clock::now();
+        Clock::time_point done = phaseStart;
+        if (ok && options.workload == WORKLOAD_WALK) {
+            result.checksum = adapter.walk();
+            done = Clock::now();
+        } else if (ok && (options.workload == WORKLOAD_DUMP || options.workload == WORKLOAD_PRETTY)) {
+            result.outputBytes = adapter.dump(options.workload == WORKLOAD_PRETTY);
+            done = Clock::now();
+        }
+        if (track)
+            result.phaseAllocs += allocTrackingStop();
+        if (timed && options.counters)
+            options.counters->stop();
+        if (timed)
+            result.minorFaults += minorFaults() - faults;
+
+        if (track)
+            allocTrackingStart();
+        adapter.clear();
+        if (track)
+            result.teardownAllocs += allocTrackingStop();
+        input.release();
+
+        if (!ok)
+            return result;
+        if (options.workload >= WORKLOAD_DUMP && result.outputBytes == 0) {
+            result.supported = false;
+            return result;
+        }
+        if (timed) {
+            result.parseNs.push_back(elapsedNs(start, parsed));
+            if (options.workload != WORKLOAD_PARSE)
+                result.phaseNs.push_back(elapsedNs(phaseStart, done));
+        }
+    }
+    if (options.counters)
+        result.perf = options.counters->read();
+    result.ok = true;
+    return result;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "adapters.h"
+#include "alloc_tracker.h"
+#include "corpus.h"
+#include "perf_counters.h"
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+inline uint64_t elapsedNs(Clock::time_point start, Clock::time_point stop) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+}
+
+enum Workload {
+    WORKLOAD_PARSE,  // parse to DOM
+    WORKLOAD_WALK,   // parse, then traverse every value
+    WORKLOAD_DUMP,   // parse, then re-serialize compactly
+    WORKLOAD_PRETTY, // parse, then re-serialize indented
+};
+
+const char *workloadName(Workload workload);
+bool workloadFromName(const char *name, Workload &workload);
+
+// Where the input of every iteration comes from. Only CACHE_HOT lets the
+// document, the parser's buffers and the code stay in cache between
+// iterations.
+enum CacheMode {
+    CACHE_HOT,   // the same buffer, refilled before each parse
+    CACHE_EVICT, // as hot, then a buffer larger than the LLC is swept
+    CACHE_MMAP,  // a fresh private mapping of a file, faulted in by the parser
+    CACHE_FRESH, // a newly malloc'd buffer per iteration
+};
+
+const char *cacheModeName(CacheMode mode);
+bool cacheModeFromName(const char *name, CacheMode &mode);
+
+struct RunOptions {
+    int warmup = 10;
+    int iterations = 100;
+    Workload workload = WORKLOAD_PARSE;
+    // When set, counts both phases of every timed iteration.
+    PerfCounters *counters = nullptr;
+    // Counts heap traffic of the parse, walk/dump and teardown phases.
+    bool trackAllocs = false;
+    // Configures the adapter to keep its buffers across parses.
+    bool reuse = false;
+    CacheMode cache = CACHE_HOT;
+};
+
+struct RunResult {
+    std::string library;
+    std::string corpus;
+    Workload workload = WORKLOAD_PARSE;
+    CacheMode cache = CACHE_HOT;
+    size_t bytes = 0;
+    bool ok = false;
+    bool supported = true;
+    uint64_t checksum = 0;    // walk checksum, WORKLOAD_WALK only
+    size_t outputBytes = 0;   // serialized size, WORKLOAD_DUMP and _PRETTY
+    // ns per document, one entry per timed iteration and phase. phaseNs
+    // holds the walk or dump phase and is empty for WORKLOAD_PARSE.
+    std::vector<uint64_t> parseNs;
+    std::vector<uint64_t> phaseNs;
+    PerfReading perf; // summed over all timed iterations
+    // Heap traffic summed over all timed iterations (peak is the maximum).
+    bool reused = false;
+    AllocStats parseAllocs;
+    AllocStats phaseAllocs;
+    AllocStats teardownAllocs;
+    // Minor page faults summed over the timed phases of all iterations.
+    uint64_t minorFaults = 0;
+
+    // Workload name, suffixed with the cache mode unless it is hot.
+    std::string label() const;
+    // parse + walk/dump time of every timed iteration.
+    std::vector<uint64_t> totalNs() const;
+    // Throughput at the median total time.
+    double mbPerSec() const;
+    // Serialized bytes per second at the median walk/dump phase time.
+    double outputMbPerSec() const;
+};
+
+// Runs one workload warmup + iterations times. Every iteration parses a
+// fresh copy of the input prepared as options.cache says; preparing the
+// input and teardown are not timed.
+RunResult runBenchmark(Adapter &adapter, const Corpus &corpus, const RunOptions &options);
@@ -0,0 +1,129 @@
+#include "scaling.h"
+
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+class Barrier {
+public:
+    explicit Barrier(int count) : count(count), waiting(0), generation(0) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        unsigned current = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            ++generation;
+            ready.notify_all();
+        } else {
+            ready.wait(lock, [&] { return generation != current; });
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    int count;
+    int waiting;
+    unsigned generation;
+};
+
+struct Worker {
+    bool ok = true;
+    bool supported = true;
+    uint64_t checksum = 0;
+    Clock::time_point start;
+    Clock::time_point stop;
+};
+
+static bool runOnce(Adapter &adapter, std::vector<char> &buffer, const Corpus &corpus, Workload workload,
+                    Worker &worker) {
+    memcpy(buffer.data(), corpus.data.c_str(), buffer.size());
+    bool ok = adapter.parse(buffer.data(), corpus.data.size());
+    if (ok && workload == WORKLOAD_WALK) {
+        worker.checksum = adapter.walk();
+    } else if (ok && workload >= WORKLOAD_DUMP && adapter.dump(workload == WORKLOAD_PRETTY) == 0) {
+        worker.supported = false;
+        ok = false;
+    }
+    adapter.clear();
+    return ok;
+}
+
+static void work(const AdapterInfo &info, const Corpus &corpus, const RunOptions &options, Barrier &barrier,
+                 Worker &worker) {
+    // Adapter and buffer are created on the thread that uses them, so their
+    // first-touch pages and allocator arenas are thread-local.
+    std::unique_ptr<Adapter> adapter = info.create();
+    std::vector<char> buffer(corpus.data.size() + 1);
+    if (options.reuse)
+        adapter->setReuse(true);
+
+    for (int i = 0; i < options.warmup && worker.ok; ++i)
+        worker.ok = runOnce(*adapter, buffer, corpus, options.workload, worker);
+
+    // Threads that failed still take part in the barrier and skip the work.
+    barrier.wait();
+    worker.start = Clock::now();
+    for (int i = 0; i < options.iterations && worker.ok; ++i)
+        worker.ok = runOnce(*adapter, buffer, corpus, options.workload, worker);
+    worker.stop = Clock::now();
+}
+
+} // namespace
+
+double ScalingResult::documentsPerSec() const {
+    return wallNs ? documents * 1e9 / wallNs : 0;
+}
+
+double ScalingResult::mbPerSec() const {
+    return wallNs ? double(documents) * bytes * 1e3 / wallNs : 0;
+}
+
+ScalingResult runScaling(const AdapterInfo &info, const Corpus &corpus, const RunOptions &options, int threads) {
+    ScalingResult result;
+    result.library = info.name;
+    result.corpus = corpus.name;
+    result.workload = options.workload;
+    result.threads = threads;
+    result.bytes = corpus.data.size();
+
+    Barrier barrier(threads);
+    std::vector<Worker> workers(threads);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back(work, std::cref(info), std::cref(corpus), std::cref(options), std::ref(barrier),
+                          std::ref(workers[t]));
+    for (std::thread &thread : pool)
+        thread.join();
+
+    Clock::time_point first = workers[0].start;
+    Clock::time_point last = workers[0].stop;
+    for (const Worker &worker : workers) {
+        if (!worker.ok) {
+            result.supported = worker.supported;
+            return result;
+        }
+        if (worker.checksum != workers[0].checksum)
+            return result;
+        first = std::min(first, worker.start);
+        last = std::max(last, worker.stop);
+        result.threadNs.push_back(elapsedNs(worker.start, worker.stop));
+    }
+    result.documents = uint64_t(threads) * options.iterations;
+    result.wallNs = elapsedNs(first, last);
+    result.ok = true;
+    return result;
+}
+
+std::vector<int> threadCounts(int maxThreads) {
+    std::vector<int> counts;
+    for (int n = 1; n < maxThreads; n *= 2)
+        counts.push_back(n);
+    counts.push_back(maxThreads);
+    return counts;
+}
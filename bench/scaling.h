@@ -0,0 +1,37 @@
+#pragma once
+
+#include "adapters.h"
+#include "corpus.h"
+#include "runner.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// N threads parsing the same corpus at once, each with its own adapter and
+// its own copy of the input, so nothing is shared but the heap and the
+// memory bus.
+struct ScalingResult {
+    std::string library;
+    std::string corpus;
+    Workload workload = WORKLOAD_PARSE;
+    int threads = 0;
+    size_t bytes = 0;
+    bool ok = false;
+    bool supported = true;
+    uint64_t documents = 0; // parsed by all threads in the timed section
+    uint64_t wallNs = 0;    // first thread released to last thread done
+    // Time each thread spent in its own timed loop.
+    std::vector<uint64_t> threadNs;
+
+    double documentsPerSec() const;
+    double mbPerSec() const;
+};
+
+// Runs warmup + iterations documents on each of threads threads. All
+// threads finish warmup before any starts its timed loop. Only
+// options.warmup, iterations, workload and reuse are honoured.
+ScalingResult runScaling(const AdapterInfo &info, const Corpus &corpus, const RunOptions &options, int threads);
+
+// 1, 2, 4, ... up to and including maxThreads.
+std::vector<int> threadCounts(int maxThreads);
@@ -0,0 +1,120 @@
+#include "startup.h"
+#include "runner.h"
+
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static uint64_t minorFaults() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+// steady_clock is CLOCK_MONOTONIC on Linux, which is shared by all
+// processes, so parent and child timestamps can be subtracted.
+static uint64_t monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+int firstParseMain(const char *library, const char *path) {
+    Corpus corpus;
+    if (!loadCorpus(path, corpus))
+        return 1;
+    std::vector<char> buffer(corpus.data.begin(), corpus.data.end());
+    buffer.push_back('\0');
+
+    uint64_t faults = minorFaults();
+    Clock::time_point start = Clock::now();
+    std::unique_ptr<Adapter> adapter;
+    for (const AdapterInfo &info : adapterRegistry()) {
+        if (!strcmp(info.name, library))
+            adapter = info.create();
+    }
+    if (!adapter)
+        return 1;
+    bool ok = adapter->parse(buffer.data(), corpus.data.size());
+    Clock::time_point parsed = Clock::now();
+    uint64_t done = monotonicNs();
+    uint64_t parseFaults = minorFaults() - faults;
+    faults += parseFaults;
+
+    adapter->clear();
+    memcpy(buffer.data(), corpus.data.c_str(), buffer.size());
+    Clock::time_point again = Clock::now();
+    ok = adapter->parse(buffer.data(), corpus.data.size()) && ok;
+    Clock::time_point reparsed = Clock::now();
+    adapter->clear();
+
+    printf("%d %llu %llu %llu %llu %llu\n", ok, (unsigned long long)done,
+           (unsigned long long)elapsedNs(start, parsed), (unsigned long long)elapsedNs(again, reparsed),
+           (unsigned long long)faults, (unsigned long long)parseFaults);
+    return 0;
+}
+
+// Runs one child and reads back its line; false if it failed.
+static bool spawnOnce(const char *self, const char *library, const std::string &path, StartupSample &sample) {
+    int fds[2];
+    if (pipe(fds) != 0)
+        return false;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    char *argv[] = {(char *)self, (char *)"--first-parse", (char *)library, (char *)path.c_str(), nullptr};
+
+    pid_t pid;
+    uint64_t spawned = monotonicNs();
+    int error = posix_spawn(&pid, self, &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (error) {
+        close(fds[0]);
+        return false;
+    }
+
+    std::string out;
+    char buf[256];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+        out.append(buf, n);
+    close(fds[0]);
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return false;
+
+    int ok;
+    unsigned long long done, first, second, faults, parseFaults;
+    if (sscanf(out.c_str(), "%d %llu %llu %llu %llu %llu", &ok, &done, &first, &second, &faults, &parseFaults) != 6 ||
+        !ok || done < spawned)
+        return false;
+    sample.firstDocumentNs = done - spawned;
+    sample.firstParseNs = first;
+    sample.secondParseNs = second;
+    sample.faults = faults;
+    sample.parseFaults = parseFaults;
+    return true;
+}
+
+StartupResult runStartup(const char *self, const AdapterInfo &info, const Corpus &corpus, int warmup,
+                         int processes) {
+    StartupResult result;
+    result.library = info.name;
+    result.corpus = corpus.name;
+    result.bytes = corpus.data.size();
+    for (int i = 0; i < warmup + processes; ++i) {
+        StartupSample sample;
+        if (!spawnOnce(self, info.name, corpus.path, sample))
+            return result;
+        if (i >= warmup)
+            result.samples.push_back(sample);
+    }
+    result.ok = true;
+    return result;
+}
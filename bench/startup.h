@@ -0,0 +1,34 @@
+#pragma once
+
+#include "adapters.h"
+#include "corpus.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// One fresh process that reads a corpus and parses it twice.
+struct StartupSample {
+    uint64_t firstDocumentNs = 0; // spawn to the first parse returning
+    uint64_t firstParseNs = 0;    // adapter construction plus first parse
+    uint64_t secondParseNs = 0;   // the same document again, warm
+    uint64_t faults = 0;          // minor faults up to the first document
+    uint64_t parseFaults = 0;     // of which during the first parse
+};
+
+struct StartupResult {
+    std::string library;
+    std::string corpus;
+    size_t bytes = 0;
+    bool ok = false;
+    std::vector<StartupSample> samples;
+};
+
+// Spawns self once per sample with the hidden --first-parse arguments.
+// warmup processes run first and are discarded, so the executable and the
+// corpus are in the page cache.
+StartupResult runStartup(const char *self, const AdapterInfo &info, const Corpus &corpus, int warmup,
+                         int processes);
+
+// Body of such a child: prints one line of measurements on stdout.
+int firstParseMain(const char *library, const char *path);
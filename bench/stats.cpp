@@ -0,0 +1,88 @@
+#include "stats.h"
+#include "random.h"
+
+#include <algorithm>
+
+static const int kResamples = 1000;
+static const uint64_t kSeed = 0x5EED;
+
+double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    double rank = p / 100 * (sorted.size() - 1);
+    size_t lo = (size_t)rank;
+    if (lo + 1 >= sorted.size())
+        return sorted.back();
+    return sorted[lo] + (rank - lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+static std::vector<double> sortedCopy(const std::vector<uint64_t> &samples) {
+    std::vector<double> v(samples.begin(), samples.end());
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+// One bootstrap replicate of the p-th percentile of samples.
+static double resample(const std::vector<uint64_t> &samples, double p, Random &rng, std::vector<double> &scratch) {
+    scratch.resize(samples.size());
+    for (double &x : scratch)
+        x = (double)samples[rng.below(samples.size())];
+    std::sort(scratch.begin(), scratch.end());
+    return percentile(scratch, p);
+}
+
+Summary summarize(const std::vector<uint64_t> &samples, double confidence) {
+    Summary s;
+    if (samples.empty())
+        return s;
+
+    std::vector<double> sorted = sortedCopy(samples);
+    s.n = sorted.size();
+    for (double x : sorted)
+        s.mean += x;
+    s.mean /= s.n;
+    s.min = sorted.front();
+    s.max = sorted.back();
+    s.median = percentile(sorted, 50);
+    s.p90 = percentile(sorted, 90);
+    s.p99 = percentile(sorted, 99);
+
+    Random rng(kSeed);
+    std::vector<double> medians(kResamples), scratch;
+    for (double &m : medians)
+        m = resample(samples, 50, rng, scratch);
+    std::sort(medians.begin(), medians.end());
+    s.medianLow = percentile(medians, 50 * (1 - confidence));
+    s.medianHigh = percentile(medians, 100 - 50 * (1 - confidence));
+    return s;
+}
+
+Comparison comparePercentile(const std::vector<uint64_t> &baseline, const std::vector<uint64_t> &current,
+                             double p, double threshold, double confidence) {
+    Comparison c;
+    if (baseline.empty() || current.empty())
+        return c;
+
+    double before = percentile(sortedCopy(baseline), p);
+    double after = percentile(sortedCopy(current), p);
+    if (before <= 0)
+        return c;
+    c.ratio = after / before;
+
+    Random rng(kSeed);
+    std::vector<double> ratios(kResamples), scratch;
+    for (double &r : ratios) {
+        double b = resample(baseline, p, rng, scratch);
+        double a = resample(current, p, rng, scratch);
+        r = b > 0 ? a / b : 1;
+    }
+    std::sort(ratios.begin(), ratios.end());
+    c.low = percentile(ratios, 50 * (1 - confidence));
+    c.high = percentile(ratios, 100 - 50 * (1 - confidence));
+
+    if (c.low > 1 && c.ratio > 1 + threshold)
+        c.verdict = VERDICT_SLOWER;
+    else if (c.high < 1 && c.ratio < 1 - threshold)
+        c.verdict = VERDICT_FASTER;
+    return c;
+}
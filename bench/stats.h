@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct Summary {
+    size_t n = 0;
+    double mean = 0;
+    double min = 0;
+    double median = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+    // Bootstrap confidence interval of the median.
+    double medianLow = 0;
+    double medianHigh = 0;
+};
+
+// Linear interpolation between closest ranks; sorted must be ascending.
+double percentile(const std::vector<double> &sorted, double p);
+
+Summary summarize(const std::vector<uint64_t> &samples, double confidence = 0.95);
+
+enum Verdict {
+    VERDICT_SAME,
+    VERDICT_FASTER,
+    VERDICT_SLOWER,
+};
+
+struct Comparison {
+    double ratio = 1; // current / baseline
+    double low = 1;   // bootstrap confidence interval of ratio
+    double high = 1;
+    Verdict verdict = VERDICT_SAME;
+};
+
+// Compares the p-th percentile of two independent sample sets by
+// resampling both. A change is only reported when the confidence interval
+// of current/baseline excludes 1 and the point estimate moved by more than
+// threshold (e.g. 0.02 for 2%).
+Comparison comparePercentile(const std::vector<uint64_t> &baseline, const std::vector<uint64_t> &current,
+                             double p, double threshold, double confidence = 0.95);
@@ -0,0 +1,655 @@
+// Checks gason's parsers and writer against each other and against the C
+// library on seeded random inputs and the bundled corpora: the in situ,
+// const-buffer, push and batch parsers must build the same trees and
+// report the same errors, numbers must read back to the bits strtod gives,
+// jsonWrite output must parse back to the same tree, and UTF-8 validation
+// must agree with a plain reading of table 3-7 of the Unicode standard.
+// Const buffers end flush against an inaccessible page, so a read past
+// that page faults; with GASONTEST_HEAP_BUFFERS, as in the AddressSanitizer
+// build, they are exact-size heap blocks instead, so that any byte read
+// outside them is reported.
+
+#include "corpus.h"
+#include "random.h"
+
+#include "gason/gason.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+// Reports the first few failures of the whole run in detail.
+void fail(const char *format, ...) {
+    if (++failures > 20)
+        return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+std::string printable(const std::string &s) {
+    std::string out;
+    for (unsigned char c : s) {
+        char hex[8];
+        if (c >= ' ' && c < 0x7F && c != '\\') {
+            out += (char)c;
+        } else {
+            snprintf(hex, sizeof(hex), "\\x%02x", c);
+            out += hex;
+        }
+    }
+    return out.size() > 80 ? out.substr(0, 80) + "..." : out;
+}
+
+#if defined(GASONTEST_HEAP_BUFFERS)
+// place() copies data to a heap block of its exact size, freeing the one
+// before.
+class GuardedBuffer {
+    char *last = nullptr;
+
+public:
+    explicit GuardedBuffer(size_t) {}
+    GuardedBuffer(const GuardedBuffer &) = delete;
+    GuardedBuffer &operator=(const GuardedBuffer &) = delete;
+    ~GuardedBuffer() {
+        free(last);
+    }
+    const char *place(const char *data, size_t length) {
+        free(last);
+        last = (char *)malloc(length);
+        if (!last && length) {
+            perror("gasontest: malloc");
+            exit(2);
+        }
+        memcpy(last, data, length);
+        return last;
+    }
+    const char *place(const std::string &s) {
+        return place(s.data(), s.size());
+    }
+};
+#else
+// A mapping whose last page is PROT_NONE; place() copies data so that it
+// ends where that page starts.
+class GuardedBuffer {
+    char *map;
+    size_t size;
+    size_t page;
+
+public:
+    explicit GuardedBuffer(size_t capacity) {
+        page = (size_t)sysconf(_SC_PAGESIZE);
+        size = (capacity + page - 1) / page * page + page;
+        map = (char *)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED || mprotect(map + size - page, page, PROT_NONE)) {
+            perror("gasontest: mmap");
+            exit(2);
+        }
+    }
+    GuardedBuffer(const GuardedBuffer &) = delete;
+    GuardedBuffer &operator=(const GuardedBuffer &) = delete;
+    ~GuardedBuffer() {
+        munmap(map, size);
+    }
+    const char *place(const char *data, size_t length) {
+        char *p = map + size - page - length;
+        memcpy(p, data, length);
+        return p;
+    }
+    const char *place(const std::string &s) {
+        return place(s.data(), s.size());
+    }
+};
+#endif
+
+GuardedBuffer guard(1 << 20);
+
+struct Parse {
+    int status;
+    size_t offset; // of *endptr
+    JsonValue value;
+};
+
+Parse parseInSitu(const std::string &s, std::vector<char> &buffer, JsonAllocator &allocator,
+                  bool validateUtf8 = false) {
+    buffer.assign(s.begin(), s.end());
+    buffer.push_back('\0');
+    buffer.shrink_to_fit();
+    Parse p;
+    char *endptr;
+    p.status = jsonParse(buffer.data(), &endptr, &p.value, allocator, validateUtf8);
+    p.offset = endptr - buffer.data();
+    return p;
+}
+
+Parse parseConst(const std::string &s, JsonAllocator &allocator, bool validateUtf8 = false) {
+    const char *data = guard.place(s);
+    Parse p;
+    const char *endptr;
+    p.status = jsonParse(data, s.size(), &endptr, &p.value, allocator, validateUtf8);
+    p.offset = endptr - data;
+    return p;
+}
+
+// Feeds s in chunks of 1 to maxChunk bytes, each placed against the guard
+// page and overwritten by the next.
+Parse parsePush(const std::string &s, size_t maxChunk, Random &random, JsonAllocator &allocator) {
+    JsonPushParser parser(allocator);
+    Parse p;
+    p.status = JSON_OK;
+    for (size_t offset = 0; offset < s.size() && p.status == JSON_OK;) {
+        size_t n = 1 + random.below(maxChunk);
+        if (n > s.size() - offset)
+            n = s.size() - offset;
+        p.status = parser.feed(guard.place(s.data() + offset, n), n);
+        offset += n;
+    }
+    if (p.status == JSON_OK)
+        p.status = parser.finish(&p.value);
+    p.offset = parser.getErrorOffset();
+    return p;
+}
+
+JsonStringView keyOf(JsonValue object, const JsonNode *node) {
+    if (object.hasKeyViews())
+        return *node->keyView;
+    return JsonStringView{node->key, strlen(node->key)};
+}
+
+bool same(JsonStringView a, JsonStringView b) {
+    return a.length == b.length && !memcmp(a.data, b.data, a.length);
+}
+
+// Structural equality, whatever the parser, layout and string form.
+bool same(JsonValue a, JsonValue b) {
+    if (a.getTag() != b.getTag())
+        return false;
+    switch (a.getTag()) {
+    case JSON_NUMBER:
+        return a.ival == b.ival;
+    case JSON_INTEGER:
+        return a.toInteger() == b.toInteger();
+    case JSON_STRING:
+        return same(a.toStringView(), b.toStringView());
+    case JSON_ARRAY:
+    case JSON_OBJECT: {
+        JsonNode *p = a.toNode(), *q = b.toNode();
+        for (; p && q; p = p->next, q = q->next) {
+            if (a.getTag() == JSON_OBJECT && !same(keyOf(a, p), keyOf(b, q)))
+                return false;
+            if (!same(p->value, q->value))
+                return false;
+        }
+        return !p && !q;
+    }
+    default:
+        return true;
+    }
+}
+
+std::string write(JsonValue value, int indent = 0) {
+    JsonBuffer buffer;
+    if (jsonWrite(value, buffer, indent) != JSON_OK)
+        return "<write failed>";
+    return std::string(buffer.data, buffer.size);
+}
+
+bool appendOutput(void *context, const char *data, size_t size) {
+    ((std::string *)context)->append(data, size);
+    return true;
+}
+
+// Random inputs over the characters of JSON, which are mostly invalid.
+std::string randomToken(Random &random) {
+    static const char alphabet[] = "{}[]\":,\\ 0123456789.-+eEtruefalsnu\n\t/bx";
+    std::string s;
+    for (size_t n = random.below(24); n; --n)
+        s += alphabet[random.below(sizeof(alphabet) - 1)];
+    return s;
+}
+
+const char *const kCases[] = {
+    "1", "-", "-1", "12.5e", "12.5e+3", "1e400", "\"abc\"", "\"abc", "\"a\\", "\"a\\u12", "\"\\u00e9\\n\"", "true", "tru",
+    "null", "nul", "false", "[1,2", "{\"a\":1}", "{\"a\\\"b\":\"x\\ty\"}", "  ", "", "[]  ",
+    "123456789012345678901234567890", "0.1000000000000000055511151231257827021181583404541015625",
+    "[\"\\ud83d\\ude00\"]", "{\"k\" : [true,false,null, -0, 1.5, \"\"]}", "[1]x", "\"\x01\"", "[1 2]", "[\"a\"b]",
+    "[\"a\"", "{\"a\"}", "{1:2}", "[-]", "[-x]", "[truex]",
+};
+
+std::vector<Corpus> loadCorpora() {
+    std::vector<Corpus> corpora;
+    for (const std::string &path : defaultCorpusPaths(GASONTEST_CORPUS_DIR)) {
+        Corpus corpus;
+        if (!loadCorpus(path, corpus)) {
+            fail("cannot read %s", path.c_str());
+            continue;
+        }
+        corpora.push_back(corpus);
+    }
+    return corpora;
+}
+
+// Numbers.
+
+void checkDouble(const std::string &token) {
+    std::vector<char> buffer;
+    JsonAllocator allocator;
+    Parse p = parseInSitu(token, buffer, allocator);
+    double expected = strtod(token.c_str(), nullptr);
+    JsonValue e(expected);
+    if (p.status != JSON_OK || p.value.getTag() != JSON_NUMBER || p.value.ival != e.ival) {
+        fail("number %s: %s, %.17g instead of %.17g", token.c_str(), jsonStrError(p.status),
+             p.status == JSON_OK ? p.value.toNumber() : 0.0, expected);
+        return;
+    }
+    Parse q = parseConst(token, allocator);
+    if (q.status != JSON_OK || q.value.ival != e.ival)
+        fail("number %s: const parse differs", token.c_str());
+}
+
+void checkInteger(int64_t n) {
+    char token[32];
+    snprintf(token, sizeof(token), "%" PRId64, n);
+    std::vector<char> buffer;
+    JsonAllocator allocator;
+    Parse p = parseInSitu(token, buffer, allocator);
+    if (p.status != JSON_OK || p.value.getTag() != JSON_INTEGER || p.value.toInteger() != n)
+        fail("integer %s: %s", token, jsonStrError(p.status));
+    Parse q = parseConst(token, allocator);
+    if (q.status != JSON_OK || q.value.getTag() != JSON_INTEGER || q.value.toInteger() != n)
+        fail("integer %s: const parse differs", token);
+}
+
+void testNumbers(Random &random) {
+    static const char *const edges[] = {
+        "0.0", "-0.0", "1e-400", "1e400", "-1e400", "4.9e-324", "2.4703282292062327e-324", "2.2250738585072011e-308",
+        "2.2250738585072014e-308", "1.7976931348623157e308", "1.7976931348623159e308", "9007199254740993.0",
+        "0.1000000000000000055511151231257827021181583404541015625", "7.3177701707893310e+15",
+        "123456789012345678901234567890.0", "1.00000000000000011102230246251565404236316680908203125",
+    };
+    for (const char *token : edges)
+        checkDouble(token);
+    char token[64];
+    for (int i = 0; i < 200000; ++i) {
+        // Every finite bit pattern, printed exactly and then shortened.
+        uint64_t bits = random.next();
+        double x;
+        memcpy(&x, &bits, sizeof(x));
+        if (!isfinite(x))
+            continue;
+        snprintf(token, sizeof(token), "%.*e", (int)random.range(0, 17), x);
+        checkDouble(token);
+    }
+    for (int i = 0; i < 200000; ++i) {
+        // Decimal strings with up to 25 digits, around the range ends.
+        std::string s = random.chance(0.5) ? "-" : "";
+        size_t digits = 1 + random.below(25);
+        size_t point = random.below(digits + 1);
+        for (size_t k = 0; k < digits; ++k) {
+            if (k == point && k)
+                s += '.';
+            s += (char)('0' + (k || digits == 1 ? random.below(10) : 1 + random.below(9)));
+        }
+        snprintf(token, sizeof(token), "e%d", (int)random.range(-345, 310));
+        checkDouble(s + token);
+    }
+
+    checkInteger(0);
+    checkInteger(INT64_MAX);
+    checkInteger(INT64_MIN);
+    for (int64_t edge = ((int64_t)1 << 46) - 2; edge <= ((int64_t)1 << 46) + 1; ++edge) {
+        checkInteger(edge);
+        checkInteger(-edge);
+    }
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t magnitude = random.next() >> random.below(64);
+        checkInteger((int64_t)(random.chance(0.5) ? 0 - magnitude : magnitude));
+    }
+
+    // -0 keeps its sign and tokens past int64_t stay doubles.
+    checkDouble("-0");
+    checkDouble("9223372036854775808");
+    checkDouble("-9223372036854775809");
+}
+
+// Writer.
+
+void testWriter(Random &random, const std::vector<Corpus> &corpora) {
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t bits = random.next();
+        double x;
+        memcpy(&x, &bits, sizeof(x));
+        if (isnan(x))
+            continue;
+        std::string text = write(JsonValue(x));
+        std::vector<char> buffer;
+        JsonAllocator allocator;
+        Parse p = parseInSitu(text, buffer, allocator);
+        bool ok = isinf(x) ? p.status == JSON_OK && p.value.getTag() == JSON_NULL
+                           : p.status == JSON_OK && p.value.getTag() == JSON_NUMBER && p.value.ival == bits;
+        if (!ok)
+            fail("double %.17g written as %s", x, text.c_str());
+    }
+
+    for (const Corpus &corpus : corpora) {
+        for (int indent : {0, 4}) {
+            std::vector<char> buffer;
+            JsonAllocator allocator;
+            Parse p = parseInSitu(corpus.data, buffer, allocator);
+            if (p.status != JSON_OK) {
+                fail("%s: %s", corpus.name.c_str(), jsonStrError(p.status));
+                continue;
+            }
+            std::string expected = write(p.value, indent);
+            std::string sunk;
+            if (jsonWrite(p.value, appendOutput, &sunk, indent) != JSON_OK || sunk != expected)
+                fail("%s: output through a callback differs", corpus.name.c_str());
+
+            Parse view = parseConst(corpus.data, allocator);
+            if (write(view.value, indent) != expected)
+                fail("%s: output of the const parse differs", corpus.name.c_str());
+            if (jsonCompact(&view.value, allocator) != JSON_OK || write(view.value, indent) != expected)
+                fail("%s: output of the compacted const parse differs", corpus.name.c_str());
+
+            std::vector<char> again;
+            Parse reparsed = parseInSitu(expected, again, allocator);
+            if (reparsed.status != JSON_OK || !same(reparsed.value, p.value) ||
+                write(reparsed.value, indent) != expected)
+                fail("%s: output does not read back to the same tree", corpus.name.c_str());
+        }
+    }
+}
+
+// The parsers against each other.
+
+void checkConstParse(const std::string &s) {
+    std::vector<char> buffer;
+    JsonAllocator a, b;
+    Parse p = parseInSitu(s, buffer, a);
+    Parse q = parseConst(s, b);
+    bool ok = p.status == q.status && p.offset == q.offset && (p.status != JSON_OK || same(p.value, q.value));
+    // The in situ parser meets the NUL inside an unterminated string.
+    if (!ok && q.status == JSON_BAD_STRING && q.offset == s.size() &&
+        (p.status == JSON_BREAKING_BAD || p.status == JSON_OK || p.status == JSON_BAD_STRING))
+        ok = true;
+    if (!ok)
+        fail("const parse of %s: %s at %zu, in situ %s at %zu", printable(s).c_str(), jsonStrError(q.status),
+             q.offset, jsonStrError(p.status), p.offset);
+}
+
+void checkPushParse(const std::string &s, size_t maxChunk, Random &random) {
+    std::vector<char> buffer;
+    JsonAllocator a, b;
+    Parse p = parseInSitu(s, buffer, a);
+    if (p.status == JSON_OK) {
+        // jsonParse ignores what follows the value; the push parser does not.
+        size_t k = p.offset;
+        while (k < s.size() && strchr(" \t\r\n", s[k]))
+            ++k;
+        if (k != s.size())
+            return;
+    }
+    Parse q = parsePush(s, maxChunk, random, b);
+    bool ok = p.status == q.status && (p.status == JSON_OK ? same(p.value, q.value) : p.offset == q.offset);
+    if (!ok && q.offset == s.size() &&
+        ((p.status == JSON_BREAKING_BAD && q.status == JSON_BREAKING_BAD) ||
+         (q.status == JSON_BAD_STRING && (p.status == JSON_OK || p.status == JSON_BREAKING_BAD))))
+        ok = true;
+    if (!ok)
+        fail("push parse of %s in chunks up to %zu: %s at %zu, in situ %s at %zu", printable(s).c_str(), maxChunk,
+             jsonStrError(q.status), q.offset, jsonStrError(p.status), p.offset);
+}
+
+bool recordDocument(void *context, const JsonDocument &document) {
+    char line[128];
+    snprintf(line, sizeof(line), "#%zu @%zu %s @%zu ", document.index, document.offset, jsonStrError(document.status),
+             document.errorOffset);
+    ((std::string *)context)->append(line + (document.status == JSON_OK ? write(document.value) : "") + "\n");
+    return true;
+}
+
+void checkBatch(const std::string &s, int flags) {
+    std::string inSitu, view;
+    JsonAllocator a, b;
+    std::vector<char> buffer(s.begin(), s.end());
+    buffer.push_back('\0');
+    buffer.shrink_to_fit();
+    size_t n = jsonParseBatch(buffer.data(), s.size(), a, recordDocument, &inSitu, flags);
+    size_t m = jsonParseBatch(guard.place(s), s.size(), b, recordDocument, &view, flags);
+    if (n != m || inSitu != view)
+        fail("batch %s with flags %d: in situ\n%sconst\n%s", printable(s).c_str(), flags, inSitu.c_str(),
+             view.c_str());
+}
+
+void testParsers(Random &random, const std::vector<Corpus> &corpora) {
+    for (const Corpus &corpus : corpora) {
+        checkConstParse(corpus.data);
+        for (size_t chunk : {1, 3, 17, 4096, 65536})
+            checkPushParse(corpus.data, chunk, random);
+        for (size_t k = 1; k < 40 && k < corpus.data.size(); ++k) {
+            checkConstParse(corpus.data.substr(0, corpus.data.size() - k));
+            checkPushParse(corpus.data.substr(0, corpus.data.size() - k), 7, random);
+        }
+    }
+    for (const char *s : kCases) {
+        checkConstParse(s);
+        for (size_t chunk = 1; chunk < 5; ++chunk)
+            checkPushParse(s, chunk, random);
+    }
+    for (int i = 0; i < 300000; ++i) {
+        std::string s = randomToken(random);
+        checkConstParse(s);
+        checkPushParse(s, 1 + random.below(5), random);
+    }
+
+    static const char *const documents[] = {
+        "{\"a\":[1,2.5,\"x\\n\"]}", "[]", "{}", "123", "-0.5e3", "\"str\"", "true", "null", "{\"k\":{\"n\":[{}]}}",
+        "[1,", "{\"a\" 1}", "]", "tru", "\"\\q\"", "[\"\\u00e9\xc3\xa9\"]", "{\"a\":1}{\"b\":2}",
+    };
+    static const char *const separators[] = {" ", "\r\n", "\n\n", "\n", "\n", "\n"};
+    for (int i = 0; i < 20000; ++i) {
+        std::string s;
+        for (size_t n = random.below(12); n; --n)
+            s += std::string(random.pick(documents)) + random.pick(separators);
+        if (random.chance(0.5) && !s.empty())
+            s.pop_back();
+        for (int flags : {0, (int)JSON_BATCH_MULTILINE, (int)JSON_BATCH_KEEP_VALUES})
+            checkBatch(s, flags);
+    }
+}
+
+// Returns the offset of the first ill-formed sequence in s, or -1, reading
+// table 3-7 one sequence at a time.
+long utf8Reference(const std::string &s) {
+    const unsigned char *p = (const unsigned char *)s.data();
+    size_t n = s.size();
+    for (size_t i = 0; i < n;) {
+        unsigned c = p[i];
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+        size_t length;
+        unsigned low = 0x80, high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            low = c == 0xE0 ? 0xA0 : 0x80;
+            high = c == 0xED ? 0x9F : 0xBF;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            low = c == 0xF0 ? 0x90 : 0x80;
+            high = c == 0xF4 ? 0x8F : 0xBF;
+        } else {
+            return i;
+        }
+        if (i + 1 >= n || p[i + 1] < low || p[i + 1] > high)
+            return i;
+        for (size_t k = 2; k < length; ++k)
+            if (i + k >= n || (p[i + k] & 0xC0) != 0x80)
+                return i;
+        i += length;
+    }
+    return -1;
+}
+
+std::string randomStringBody(Random &random) {
+    static const char *const valid[] = {
+        "a", "xyz", "\\n", "\\u00e9", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xed\x9f\xbf", "\xee\x80\x80",
+        "\xf4\x8f\xbf\xbf", "\xdf\xbf", "\xc2\x80", "\xe0\xa0\x80", "\xf0\x90\x80\x80",
+    };
+    static const char *const invalid[] = {
+        "\x80", "\xbf", "\xc0\x80", "\xc1\xbf", "\xe0\x80\x80", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xf5", "\xff",
+        "\xe2\x82", "\xf0\x9f\x98", "\xc3", "\xe2\x82" "A", "\xf8\x88\x80\x80\x80",
+    };
+    std::string body;
+    if (random.chance(0.1)) {
+        // Anything but the bytes a plain run stops at.
+        for (size_t n = random.below(71); n; --n) {
+            char c = (char)random.range(0x20, 0xFF);
+            if (c != '"' && c != '\\' && c != '\x7F')
+                body += c;
+        }
+        return body;
+    }
+    for (size_t n = random.below(41); n; --n) {
+        double r = random.uniform();
+        if (r < 0.5)
+            body.append(1 + random.below(40), 'a');
+        else if (r < 0.97)
+            body += random.pick(valid);
+        else if (r < 0.985)
+            body += random.pick(invalid);
+        else
+            body += (char)random.range(0x80, 0xFF);
+    }
+    return body;
+}
+
+void testUtf8(Random &random) {
+    for (int i = 0; i < 300000; ++i) {
+        std::string body = randomStringBody(random);
+        long bad = utf8Reference(body);
+        std::string document = "[\"" + body + "\"]";
+        long expected = bad < 0 ? -1 : bad + 2;
+
+        std::vector<char> buffer;
+        JsonAllocator allocator;
+        Parse p = parseInSitu(document, buffer, allocator, true);
+        Parse q = parseConst(document, allocator, true);
+        // Unterminated at the very end of the buffer.
+        Parse u = parseConst("\"" + body, allocator, true);
+        Parse plain = parseInSitu(document, buffer, allocator);
+        long inSitu = p.status == JSON_BAD_UTF8 ? (long)p.offset : p.status == JSON_OK ? -1 : -100 - p.status;
+        long view = q.status == JSON_BAD_UTF8 ? (long)q.offset : q.status == JSON_OK ? -1 : -100 - q.status;
+        long cut = u.status == JSON_BAD_UTF8 ? (long)u.offset : u.status == JSON_BAD_STRING ? -1 : -100 - u.status;
+        if (inSitu != expected || view != expected || cut != (bad < 0 ? -1 : bad + 1) || plain.status != JSON_OK)
+            fail("utf-8 %s: expected %ld, in situ %ld, const %ld, unterminated %ld", printable(body).c_str(), expected,
+                 inSitu, view, cut);
+    }
+}
+
+// Lookups and layout.
+
+void checkFind(JsonValue object, const std::vector<std::string> &keys, JsonAllocator &allocator, size_t minWidth) {
+    for (const std::string &key : keys) {
+        JsonNode *expected = nullptr;
+        for (auto i : object) {
+            if (key == i->key) {
+                expected = i;
+                break;
+            }
+        }
+        if (jsonFind(object, key.c_str(), allocator, minWidth) != expected)
+            fail("jsonFind %s with minWidth %zu", key.c_str(), minWidth);
+    }
+}
+
+void checkCompact(JsonValue value) {
+    if (value.getTag() != JSON_ARRAY && value.getTag() != JSON_OBJECT)
+        return;
+    size_t n = 0;
+    for (auto i : value) {
+        if (n >= value.getLength() || value.at(n) != i)
+            fail("compact run out of order at %zu", n);
+        ++n;
+        checkCompact(i->value);
+    }
+    if (n != value.getLength())
+        fail("compact run of %zu members has length %zu", n, value.getLength());
+}
+
+void testLayout(Random &random, const std::vector<Corpus> &corpora) {
+    for (int i = 0; i < 2000; ++i) {
+        // Few distinct keys, so that objects have duplicates.
+        std::vector<std::string> keys;
+        std::string document = "{";
+        for (size_t n = random.below(40); n; --n) {
+            char key[16];
+            snprintf(key, sizeof(key), "k%d", (int)random.below(48));
+            document += std::string(document.size() > 1 ? "," : "") + "\"" + key + "\":" + std::to_string(n);
+            keys.push_back(key);
+        }
+        document += "}";
+        keys.push_back("missing");
+        keys.push_back("");
+
+        std::vector<char> buffer;
+        JsonAllocator allocator;
+        Parse p = parseInSitu(document, buffer, allocator);
+        for (size_t minWidth : {(size_t)0, (size_t)JSON_INDEX_MIN_WIDTH}) {
+            checkFind(p.value, keys, allocator, minWidth);
+            checkFind(p.value, keys, allocator, minWidth);
+        }
+        JsonValue compact = p.value;
+        if (jsonCompact(&compact, allocator) != JSON_OK || !same(compact, p.value))
+            fail("compacted object differs from %s", document.c_str());
+        checkFind(compact, keys, allocator, 0);
+    }
+
+    for (const Corpus &corpus : corpora) {
+        std::vector<char> buffer;
+        JsonAllocator allocator;
+        Parse p = parseInSitu(corpus.data, buffer, allocator);
+        JsonValue compact = p.value;
+        if (jsonCompact(&compact, allocator) != JSON_OK || !same(compact, p.value))
+            fail("%s: compacted tree differs", corpus.name.c_str());
+        checkCompact(compact);
+        Parse view = parseConst(corpus.data, allocator);
+        if (jsonCompact(&view.value, allocator) != JSON_OK || !same(view.value, p.value))
+            fail("%s: compacted const parse differs", corpus.name.c_str());
+        checkCompact(view.value);
+    }
+}
+
+} // namespace
+
+int main() {
+    Random random(1);
+    std::vector<Corpus> corpora = loadCorpora();
+    testNumbers(random);
+    testWriter(random, corpora);
+    testParsers(random, corpora);
+    testUtf8(random);
+    testLayout(random, corpora);
+    if (failures) {
+        fprintf(stderr, "gasontest: %d failures\n", failures);
+        return 1;
+    }
+    printf("gasontest: ok\n");
+    return 0;
+}